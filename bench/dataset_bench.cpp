@@ -0,0 +1,360 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <stdexcept>
+#include "../include/axial_force_dataset/axial_force_dataset.hpp"
+
+
+/**
+ * Benchmark of the stages of the dataset pipeline (JSON parsing, CSV loading,
+ * sorting, extrapolation, resampling, differentiation and point lookup) on
+ * synthetic recordings of increasing size.
+ *
+ * Usage: dataset_bench [--min N] [--max N] [--reps R] [--seed S]
+ *                      [--output results.json] [--tmp dir]
+ *
+ * The sizes go from min to max in decades (10 <= min <= max). The largest 
+ * default size (1e6 samples) needs about 70 MB of memory and a 25 MB 
+ * temporary CSV in the tmp directory, both of which grow tenfold per decade.
+**/
+
+// Width of the stage column (the longest stage name has 31 characters)
+const int stage_width = 33;
+
+
+struct BenchResult
+{
+    std::string stage;
+    u_int64_t samples;
+    u_int64_t bytes;
+    double seconds;
+};
+
+
+struct BenchConfig
+{
+    u_int64_t min_samples = 1000;
+    u_int64_t max_samples = 1000000;
+    int reps = 3;
+    unsigned int seed = 42;
+    std::string output = "dataset_bench.json";
+    std::string tmp_dir = "/tmp";
+    std::string data_id = "Data1";
+};
+
+
+/**
+ * Generates a two column recording (time, value) with irregular sampling,
+ * repeated timestamps (1%) and locally swapped rows (1%). Past about 1e7
+ * samples the float timestamps can no longer resolve the sampling interval
+ * and more of them repeat.
+ * @param n Number of samples.
+ * @param gen Random generator.
+ * @return Unsorted Armadillo matrix of type fmat.
+*/
+arma::fmat synthetic_recording(u_int64_t n, std::mt19937 &gen)
+{
+    std::uniform_real_distribution<float> unif(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, 0.01f);
+
+    // The time is accumulated in double, since float increments of 1/n are 
+    // lost once t is large next to them
+    const double dt = 1.0 / n;
+    arma::fmat x_y(n, 2);
+    double t = 0;
+
+    for (u_int64_t i = 0; i < n; i++)
+    {
+        if (i == 0 || unif(gen) > 0.01f) { t += dt * (0.5 + unif(gen)); }
+        x_y.at(i, 0) = t;
+        x_y.at(i, 1) = std::sin(6.2831853 * t) + noise(gen);
+    }
+
+    for (u_int64_t i = 1; i < n; i++)
+    {
+        if (unif(gen) < 0.01f)
+        {
+            std::swap(x_y.at(i, 0), x_y.at(i - 1, 0));
+            std::swap(x_y.at(i, 1), x_y.at(i - 1, 1));
+        }
+    }
+
+    return x_y;
+}
+
+
+u_int64_t write_csv(const std::string &filename, const arma::fmat &x_y)
+{
+    std::ofstream file(filename);
+    file << std::setprecision(9);
+
+    for (arma::uword i = 0; i < x_y.n_rows; i++)
+    {
+        file << x_y.at(i, 0) << ", " << x_y.at(i, 1) << "\n";
+    }
+
+    return file.tellp();
+}
+
+
+/**
+ * Times a stage and keeps the fastest of the repetitions.
+ * @param setup Untimed preparation executed before every repetition.
+ * @param stage The timed stage.
+*/
+double time_stage(int reps, std::function<void()> setup,
+    std::function<void()> stage)
+{
+    double best = 0;
+
+    for (int r = 0; r < reps; r++)
+    {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        stage();
+        auto stop = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        if (r == 0 || seconds < best) { best = seconds; }
+    }
+
+    return best;
+}
+
+
+void report(std::vector<BenchResult> &results, const std::string &stage,
+    u_int64_t samples, u_int64_t bytes, double seconds)
+{
+    results.push_back({stage, samples, bytes, seconds});
+
+    std::cout << std::left << std::setw(stage_width) << stage << std::right
+        << std::setw(12) << samples << std::setw(14) << std::scientific
+        << std::setprecision(3) << seconds << std::setw(14)
+        << samples / seconds << std::setw(14)
+        << ((bytes > 0) ? bytes / seconds : 0.0) << std::defaultfloat
+        << std::endl;
+}
+
+
+void bench_size(u_int64_t n, const BenchConfig &config, std::mt19937 &gen,
+    std::vector<BenchResult> &results)
+{
+    const u_int64_t mat_bytes = n * 2 * sizeof(float);
+    arma::fmat raw = synthetic_recording(n, gen);
+
+    // CSV loading
+    std::string csv_name = config.tmp_dir + "/dataset_bench_" +
+        std::to_string(n) + ".csv";
+    u_int64_t csv_bytes = write_csv(csv_name, raw);
+
+    arma::fmat loaded;
+    double sec = time_stage(config.reps, [](){}, [&]() {
+        CsvReader::load<arma::fmat>(csv_name, &loaded); });
+    report(results, "csv_load", n, csv_bytes, sec);
+
+    if (n <= 1000000)
+    {
+        sec = time_stage(config.reps, [](){}, [&]() {
+            loaded.load(csv_name, arma::csv_ascii); });
+        report(results, "csv_load_arma", n, csv_bytes, sec);
+    }
+    std::remove(csv_name.c_str());
+
+    // Sorting and duplicate removal
+    arma::fmat sorted;
+    sec = time_stage(config.reps, [&]() { sorted = raw; }, [&]() {
+        ArmaExt::sortrows<arma::fmat>(&sorted, true); });
+    report(results, "sortrows", n, mat_bytes, sec);
+
+    arma::fmat again;
+    sec = time_stage(config.reps, [&]() { again = sorted; }, [&]() {
+        ArmaExt::sortrows<arma::fmat>(&again, true); });
+    report(results, "sortrows_sorted", n, mat_bytes, sec);
+
+    // Resampling on a grid of about n samples
+    const float ts = (sorted.at(sorted.n_rows - 1, 0) - sorted.at(0, 0)) / n;
+    arma::fmat resampled;
+    sec = time_stage(config.reps, [&]() { resampled = sorted; }, [&]() {
+        AxialForceDataset::resampling(&resampled, ts); });
+    report(results, "resampling", n, mat_bytes, sec);
+
+    // Resampling with extrapolation to a 1% longer recording
+    const float t_end = sorted.at(sorted.n_rows - 1, 0) + n * ts / 100;
+    arma::fmat extended;
+    sec = time_stage(config.reps, [&]() { extended = sorted; }, [&]() {
+        AxialForceDataset::resampling(&extended, ts, t_end); });
+    report(results, "resampling_extrapolated", n, mat_bytes, sec);
+
+    // Differentiation
+    arma::fvec t_vec = resampled.col(0); arma::fvec x_vec = resampled.col(1);
+    arma::fvec u_vec;
+    sec = time_stage(config.reps, [](){}, [&]() {
+        AxialForceDataset::central_diff_derivative(t_vec, x_vec, &u_vec); });
+    report(results, "central_diff_derivative", t_vec.n_elem,
+        3 * t_vec.n_elem * sizeof(float), sec);
+
+    sec = time_stage(config.reps, [](){}, [&]() {
+        AxialForceDataset::central_diff_derivative(x_vec, ts, &u_vec); });
+    report(results, "central_diff_derivative_uniform", x_vec.n_elem,
+        2 * x_vec.n_elem * sizeof(float), sec);
+
+    Differentiator savgol(Differentiator::method::savitzky_golay, 2, 7);
+    sec = time_stage(config.reps, [](){}, [&]() {
+        savgol.apply(x_vec, ts, &u_vec); });
+    report(results, "savitzky_golay_2_7", x_vec.n_elem,
+        2 * x_vec.n_elem * sizeof(float), sec);
+
+    // Point lookup of n random queries on the resampled time axis
+    const arma::uword m = t_vec.n_elem;
+    std::uniform_real_distribution<float> unif_t(t_vec[0], t_vec[m - 1]);
+    std::vector<float> queries(n);
+    for (u_int64_t i = 0; i < n; i++) { queries[i] = unif_t(gen); }
+
+    volatile float sink = 0.0f;
+    sec = time_stage(config.reps, [](){}, [&]() {
+        float acc = 0.0f;
+        for (u_int64_t i = 0; i < n; i++)
+        {
+            arma::uword k = ChannelLookup::locate_uniform<float>(t_vec.memptr(), m,
+                1.0f / ts, queries[i]);
+            acc += ChannelLookup::interpolate<float>(t_vec.memptr(), x_vec.memptr(),
+                m, k, queries[i]);
+        }
+        sink = acc; });
+    report(results, "lookup_uniform", n, n * sizeof(float), sec);
+
+    sec = time_stage(config.reps, [](){}, [&]() {
+        float acc = 0.0f;
+        for (u_int64_t i = 0; i < n; i++)
+        {
+            arma::uword k = ChannelLookup::locate_sorted<float>(t_vec.memptr(), m,
+                queries[i]);
+            acc += ChannelLookup::interpolate<float>(t_vec.memptr(), x_vec.memptr(),
+                m, k, queries[i]);
+        }
+        sink = acc; });
+    report(results, "lookup_binary_search", n, n * sizeof(float), sec);
+    (void) sink;
+}
+
+
+void bench_json(const BenchConfig &config, std::vector<BenchResult> &results)
+{
+    std::string json_name = "./include/axial_force_dataset/share/" +
+        config.data_id + "/" + config.data_id + ".json";
+    std::ifstream file(json_name, std::ios::binary | std::ios::ate);
+    u_int64_t bytes = file.tellg();
+
+    const int parses = 100;
+    double sec = time_stage(config.reps, [](){}, [&]() {
+        for (int i = 0; i < parses; i++)
+        {
+            AxialForceDataset dataset;
+            dataset.set_lazy_loading(true);
+            dataset.data_parsing(config.data_id);
+        }
+    });
+    report(results, "json_metadata", parses, parses * bytes, sec);
+}
+
+
+void write_json(const BenchConfig &config,
+    const std::vector<BenchResult> &results)
+{
+    nlohmann::json j_file;
+    j_file["config"] = {{"min_samples", config.min_samples},
+        {"max_samples", config.max_samples}, {"reps", config.reps},
+        {"seed", config.seed}};
+
+    nlohmann::json j_results = nlohmann::json::array();
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult &res = results[i];
+        j_results.push_back({{"stage", res.stage}, {"samples", res.samples},
+            {"bytes", res.bytes}, {"seconds", res.seconds},
+            {"samples_per_second", res.samples / res.seconds},
+            {"bytes_per_second", res.bytes / res.seconds}});
+    }
+    j_file["results"] = j_results;
+
+    std::ofstream file(config.output);
+    file << j_file.dump(4) << std::endl;
+}
+
+
+/**
+ * Parses a number of samples (scientific notation is accepted). A recording 
+ * needs a few distinct timestamps to be resampled, so at least 10 are required.
+ * @return The number of samples.
+*/
+u_int64_t parse_samples(const std::string &val)
+{
+    const double n = std::stod(val);
+    if (!(n >= 10 && n <= 1e15)) { throw std::out_of_range(val); }
+
+    return static_cast<u_int64_t>(n);
+}
+
+
+int main(int argc, char *argv[])
+{
+    BenchConfig config;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i]; std::string val = argv[i + 1];
+
+        try
+        {
+            if (arg == "--min") { config.min_samples = parse_samples(val); }
+            else if (arg == "--max") { config.max_samples = parse_samples(val); }
+            else if (arg == "--reps") { config.reps = std::stoi(val); }
+            else if (arg == "--seed") { config.seed = std::stoul(val); }
+            else if (arg == "--output") { config.output = val; }
+            else if (arg == "--tmp") { config.tmp_dir = val; }
+            else
+            {
+                std::cerr << "Unknown argument " << arg << std::endl;
+                return 1;
+            }
+        }
+        catch (const std::exception &)
+        {
+            std::cerr << "Invalid value " << val << " of " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (config.max_samples < config.min_samples || config.reps < 1)
+    {
+        std::cerr << "Expected 10 <= min <= max and reps >= 1" << std::endl;
+        return 1;
+    }
+
+    std::mt19937 gen(config.seed);
+    std::vector<BenchResult> results;
+
+    std::cout << std::left << std::setw(stage_width) << "stage" << std::right
+        << std::setw(12) << "samples" << std::setw(14) << "seconds"
+        << std::setw(14) << "samples/s" << std::setw(14) << "bytes/s"
+        << std::endl;
+
+    bench_json(config, results);
+
+    for (u_int64_t n = config.min_samples; n <= config.max_samples; n *= 10)
+    {
+        bench_size(n, config, gen, results);
+        if (n > config.max_samples / 10) { break; }
+    }
+
+    write_json(config, results);
+    return 0;
+}
@@ -5,6 +5,8 @@
 #include <armadillo>
 #include <vector>
 #include <fstream>
+#include <algorithm>
+#include <utility>
 
 
 class ArmaExt
@@ -12,69 +14,361 @@ class ArmaExt
     public:
         ArmaExt();
 
+        /// Aggregation applied to rows that share the same first column value.
+        enum class dup_policy
+        {
+            keep_first, keep_last, mean, median
+        };
+
         template <typename T>
-        static void sortrows(T *matr, bool clear_reduntant=false);
+        static void sortrows(T *matr, bool clear_reduntant=false, 
+            dup_policy policy=dup_policy::keep_last);
+
+        template <typename T>
+        static void collapse_duplicates(T *matr, 
+            dup_policy policy=dup_policy::keep_last);
+
+        template <typename T>
+        static void resampling(T *matr, typename T::elem_type ts);
 
-    private:
         template <typename T>
-        static bool compare_head(const arma::Mat<typename T::elem_type>& lhs, const arma::Mat<typename T::elem_type>& rhs);
+        static void resampling(T *matr, typename T::elem_type ts, 
+            typename T::elem_type t_end);
+
+        template <typename T>
+        static void resampling(T *matr, typename T::elem_type ts, 
+            typename T::elem_type t_start, typename T::elem_type t_end);
+
+        template <typename eT>
+        static std::vector<std::pair<arma::uword, arma::uword>> monotone_runs(
+            const eT *x, arma::uword n, eT min_excursion=eT(0));
+
+        template <typename eT>
+        static void central_diff(const eT *t, const eT *x, eT *u, arma::uword n);
+
+        template <typename eT>
+        static void central_diff_uniform(const eT *x, eT ts, eT *u, arma::uword n);
+
+    private:
 };
 
 
 /**
- * Sorts in ascending order an Armadillo matrix of type T according to it's first row 
+ * Sorts in ascending order an Armadillo matrix of type T according to it's first column.
+ * The rows are reordered through a single gather of a stable permutation of the 
+ * first column, and already sorted matrices are left untouched.
  * @param mat Armadillo matrix of type T
+ * @param clear_reduntant Collapse rows with the same first column value
+ * @param policy Aggregation of the collapsed rows
  * @return Sorted Armadillo matrix of type T
 */
 template <typename T>
-void ArmaExt::sortrows(T *matr, bool clear_reduntant)
+void ArmaExt::sortrows(T *matr, bool clear_reduntant, dup_policy policy)
 {  
-    std::vector< arma::Mat<typename T::elem_type> > vec;
+    typedef typename T::elem_type eT;
 
+    const arma::uword n_rows = matr->n_rows;
+    const arma::uword n_cols = matr->n_cols;
+    const eT *key = matr->colptr(0);
 
-    for (int64_t i = 0; i < matr->n_rows; ++i)
+    if (!std::is_sorted(key, key + n_rows))
     {
-        vec.push_back(matr->row(i));
+        std::vector<arma::uword> perm(n_rows);
+        for (arma::uword i = 0; i < n_rows; i++) { perm[i] = i; }
+
+        std::stable_sort(perm.begin(), perm.end(), 
+            [key](arma::uword lhs, arma::uword rhs) { return key[lhs] < key[rhs]; });
+
+        T mat_s(n_rows, n_cols);
+
+        for (arma::uword j = 0; j < n_cols; j++)
+        {
+            const eT *src = matr->colptr(j); eT *dst = mat_s.colptr(j);
+            for (arma::uword i = 0; i < n_rows; i++) { dst[i] = src[perm[i]]; }
+        }
+
+        matr->steal_mem(mat_s);
     }
 
-    std::sort(vec.begin(), vec.end(), &compare_head<T>);
+    if(clear_reduntant) { collapse_duplicates<T>(matr, policy); }
+}
+
+
+/**
+ * Collapses consecutive rows of a sorted Armadillo matrix of type T that share 
+ * the same first column value into a single row. The compaction is done in place 
+ * in one sweep over the contiguous column memory.
+ * @param matr Armadillo matrix of type T
+ * @param policy Aggregation of the duplicate rows
+*/
+template <typename T>
+void ArmaExt::collapse_duplicates(T *matr, dup_policy policy)
+{
+    typedef typename T::elem_type eT;
+
+    const arma::uword n_rows = matr->n_rows;
+    const arma::uword n_cols = matr->n_cols;
+    if (n_rows < 2 || n_cols == 0) { return; }
 
-    for (int64_t i = 0; i < matr->n_rows; ++i)
+    const eT *key = matr->colptr(0);
+    std::vector<eT> scratch;
+
+    arma::uword w = 0;
+    for (arma::uword s = 0; s < n_rows; w++)
     {
-            matr->row(i) = vec[i];
+        // Duplicate run [s, e)
+        arma::uword e = s + 1;
+        while (e < n_rows && key[e] == key[s]) { e++; }
+        const arma::uword n = e - s;
+
+        for (arma::uword j = 0; j < n_cols; j++)
+        {
+            eT *col = matr->colptr(j);
+            eT val;
+
+            if (n == 1 || policy == dup_policy::keep_first) { val = col[s]; }
+            else if (policy == dup_policy::keep_last) { val = col[e - 1]; }
+            else if (policy == dup_policy::mean)
+            {
+                eT sum = 0;
+                for (arma::uword i = s; i < e; i++) { sum += col[i]; }
+                val = sum / (eT) n;
+            }
+            else
+            {
+                scratch.assign(col + s, col + e);
+                typename std::vector<eT>::iterator mid = scratch.begin() + n / 2;
+                std::nth_element(scratch.begin(), mid, scratch.end());
+                val = *mid;
+
+                if (n % 2 == 0)
+                {
+                    val = (val + *std::max_element(scratch.begin(), mid)) / 2;
+                }
+            }
+
+            col[w] = val;
+        }
+
+        s = e;
     }
 
-    if(clear_reduntant)
+    if (w < n_rows) { matr->shed_rows(w, n_rows - 1); }
+}
+
+
+/**
+ * Resamples a sorted (ascending) Armadillo matrix of type T in intervals of ts 
+ * using linear interpolation. The first column holds the independent variable.
+ * The source column and the uniform grid are walked together in a single pass, 
+ * so the cost is linear in the number of source and target samples.
+ * @param matr Armadillo matrix of type T
+ * @param ts Sampling interval of the uniform grid
+*/
+template <typename T>
+void ArmaExt::resampling(T *matr, typename T::elem_type ts)
+{
+    resampling<T>(matr, ts, matr->at(matr->n_rows - 1, 0));
+}
+
+/**
+ * Resamples a sorted (ascending) Armadillo matrix of type T in intervals of ts 
+ * up to t_end. Grid points past the last source sample are extrapolated 
+ * linearly from the last two samples, so matrices of different lengths are 
+ * aligned without growing the source.
+ * @param matr Armadillo matrix of type T
+ * @param ts Sampling interval of the uniform grid
+ * @param t_end End of the uniform grid
+*/
+template <typename T>
+void ArmaExt::resampling(T *matr, typename T::elem_type ts, 
+    typename T::elem_type t_end)
+{
+    resampling<T>(matr, ts, matr->at(0, 0), t_end);
+}
+
+/**
+ * Resamples a sorted (ascending) Armadillo matrix of type T on the grid 
+ * t_start + k * ts up to t_end. Choosing t_start as a multiple of ts puts 
+ * matrices with different ranges on a common grid. Grid points up to the 
+ * first source sample take its values.
+ * @param matr Armadillo matrix of type T
+ * @param ts Sampling interval of the uniform grid
+ * @param t_start Start of the uniform grid
+ * @param t_end End of the uniform grid
+*/
+template <typename T>
+void ArmaExt::resampling(T *matr, typename T::elem_type ts, 
+    typename T::elem_type t_start, typename T::elem_type t_end)
+{
+    typedef typename T::elem_type eT;
+
+    const arma::uword n_src = matr->n_rows;
+    const arma::uword n_cols = matr->n_cols;
+    const eT *t = matr->colptr(0);
+    const eT t_last = t[n_src - 1];
+
+    if (t_end < t_start) { matr->set_size(0, n_cols); return; }
+
+    arma::Col<eT> tu = arma::regspace< arma::Col<eT> >(t_start, ts, t_end);
+    const arma::uword n_dst = tu.n_rows;
+
+    T mat_u(n_dst, n_cols);
+    arma::uword i = 0;
+
+    for (; i < n_dst && tu[i] <= t[0]; i++)
+    {
+        mat_u.at(i, 0) = tu[i];
+        for (arma::uword j = 1; j < n_cols; j++) { mat_u.at(i, j) = matr->at(0, j); }
+    }
+
+    // index1: last source sample strictly before tu(i)
+    // index2: first source sample strictly after tu(i)
+    arma::uword index1 = 0; arma::uword index2 = 0;
+
+    for (; i < n_dst && tu[i] <= t_last; i++)
     {
-        int64_t matu_rows = 0;
-        for (int64_t i = 0; i < matr->n_rows - 1; i++)
+        const eT tq = tu[i];
+
+        while (index1 + 1 < n_src && t[index1 + 1] < tq) { index1++; }
+        while (index2 + 1 < n_src && t[index2] <= tq) { index2++; }
+
+        // Times that tu(i) belongs in
+        const eT t1 = t[index1]; const eT t2 = t[index2];
+        const eT dt = t2 - t1; const eT dtu = t2 - tq;
+
+        mat_u.at(i, 0) = tq;
+
+        // Interpolation
+        for (arma::uword j = 1; j < n_cols; j++)
         {
-            if ((*matr)(i + 1, 0) - (*matr)(i, 0) != 0) { matu_rows++ ;}
+            const eT a1 = matr->at(index1, j); const eT a2 = matr->at(index2, j);
+            mat_u.at(i, j) = a2 - ((a2 - a1) / dt) * dtu;
         }
+    }
+
+    // Extrapolation past the source end (the slope of a single sample is 0)
+    if (i < n_dst)
+    {
+        const arma::uword last = n_src - 1;
+        const arma::uword prev = (n_src > 1) ? n_src - 2 : last;
+        const eT dt = t_last - t[prev];
 
-        arma::Mat<typename T::elem_type> mat_u(matu_rows + 1, (*matr).n_cols); 
-        mat_u.zeros();        
-        int64_t counter = 0;
-        
-        for (int64_t i = 0; i < matr->n_rows - 1; i++)
+        for (arma::uword j = 1; j < n_cols; j++)
         {
-            if ((*matr)(i + 1, 0) - (*matr)(i, 0) != 0) 
-            { 
-                mat_u.row(counter) = matr->row(i);
-                counter++;
+            const eT a_last = matr->at(last, j);
+            const eT slope = (dt > 0) ? (a_last - matr->at(prev, j)) / dt : eT(0);
+            eT *col = mat_u.colptr(j);
+
+            for (arma::uword k = i; k < n_dst; k++)
+            {
+                col[k] = a_last + slope * (tu[k] - t_last);
             }
         }
-        
-        mat_u.row(mat_u.n_rows - 1) = matr->row(matr->n_rows - 1);
-        (*matr) = mat_u;
+
+        for (arma::uword k = i; k < n_dst; k++) { mat_u.at(k, 0) = tu[k]; }
     }
-    
+
+    matr->steal_mem(mat_u);
 }
 
-template <typename T>
-bool ArmaExt::compare_head(const arma::Mat<typename T::elem_type>& lhs, const arma::Mat<typename T::elem_type>& rhs)
+
+/**
+ * Splits x into monotone runs in one pass. A change of direction is declared 
+ * only once x has moved back from the extreme of the run by more than 
+ * min_excursion, so jitter smaller than that stays inside the runs (which 
+ * are then monotone up to min_excursion). Consecutive runs share the turning 
+ * sample, and an x that never moves further is a single run.
+ * @param x Samples (n)
+ * @param n Number of samples
+ * @param min_excursion Hysteresis of the direction changes
+ * @return First and last sample of each run
+*/
+template <typename eT>
+std::vector<std::pair<arma::uword, arma::uword>> ArmaExt::monotone_runs(
+    const eT *x, arma::uword n, eT min_excursion)
 {
-    return lhs(0) < rhs(0);
+    std::vector<std::pair<arma::uword, arma::uword>> runs;
+    if (n == 0) { return runs; }
+
+    // dir: 0 until x has moved by more than min_excursion, then +1 or -1
+    // ext: extreme of the run in its direction (the last one on plateaus)
+    arma::uword first = 0; int dir = 0;
+    arma::uword ext = 0; arma::uword ext_min = 0; arma::uword ext_max = 0;
+
+    for (arma::uword i = 1; i < n; i++)
+    {
+        if (dir == 0)
+        {
+            if (x[i] >= x[ext_max]) { ext_max = i; }
+            if (x[i] <= x[ext_min]) { ext_min = i; }
+            if (x[ext_max] - x[ext_min] <= min_excursion) { continue; }
+
+            dir = (ext_max > ext_min) ? 1 : -1; ext = i;
+        }
+        else if ((dir > 0) ? (x[i] >= x[ext]) : (x[i] <= x[ext])) { ext = i; }
+        else if (((dir > 0) ? x[ext] - x[i] : x[i] - x[ext]) > min_excursion)
+        {
+            runs.push_back(std::make_pair(first, ext));
+            first = ext; dir = -dir; ext = i;
+        }
+    }
+    runs.push_back(std::make_pair(first, n - 1));
+
+    return runs;
+}
+
+
+/**
+ * Derivative of x with respect to t by central differences, with one-sided 
+ * differences on the first and last sample. The boundaries are resolved before 
+ * the interior loop, which is branch-free over contiguous memory.
+ * @param t Independent variable (n samples)
+ * @param x Dependent variable (n samples)
+ * @param u Output buffer of n samples, must not alias t or x
+ * @param n Number of samples
+*/
+template <typename eT>
+void ArmaExt::central_diff(const eT *t, const eT *x, eT *u, arma::uword n)
+{
+    const eT min_step = eT(1e-5);
+
+    if (n < 2) { std::fill(u, u + n, eT(0)); return; }
+
+    eT step = t[1] - t[0];
+    u[0] = (x[1] - x[0]) / (step == 0 ? min_step : step);
+    step = t[n - 1] - t[n - 2];
+    u[n - 1] = (x[n - 1] - x[n - 2]) / (step == 0 ? min_step : step);
+
+    for (arma::uword i = 1; i < n - 1; i++)
+    {
+        step = t[i + 1] - t[i - 1];
+        u[i] = (x[i + 1] - x[i - 1]) / (step == 0 ? min_step : step);
+    }
+}
+
+/**
+ * Central differences on a uniform grid of period ts, the interior reduces to a 
+ * multiplication by the constant 1/(2 ts).
+ * @param x Dependent variable (n samples)
+ * @param ts Sampling interval
+ * @param u Output buffer of n samples, must not alias x
+ * @param n Number of samples
+*/
+template <typename eT>
+void ArmaExt::central_diff_uniform(const eT *x, eT ts, eT *u, arma::uword n)
+{
+    if (n < 2) { std::fill(u, u + n, eT(0)); return; }
+
+    const eT inv_ts = eT(1) / ts; const eT inv_2ts = eT(0.5) * inv_ts;
+
+    u[0] = (x[1] - x[0]) * inv_ts;
+    u[n - 1] = (x[n - 1] - x[n - 2]) * inv_ts;
+
+    for (arma::uword i = 1; i < n - 1; i++)
+    {
+        u[i] = (x[i + 1] - x[i - 1]) * inv_2ts;
+    }
 }
 
 
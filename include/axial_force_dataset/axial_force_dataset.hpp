@@ -1,11 +1,42 @@
+#ifndef AXIAL_FORCE_DATASET_H
+#define AXIAL_FORCE_DATASET_H
+
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <atomic>
+#include <mutex>
+#include <future>
+#include <memory>
+#include <limits>
+#include <exception>
+#include <cmath>
 #include <armadillo>
 #include "include/armaext.hpp"
+#include "include/dataset_cache.hpp"
+#include "include/channel_span.hpp"
+#include "include/csv_reader.hpp"
+#include "include/differentiator.hpp"
+#include "include/channel_lookup.hpp"
 #include "./include/nlohmann/json.hpp"
 
 
+/**
+ * Monotone part of a recording resampled on one of its channels (see 
+ * AxialForceDataset::resample_on_axis).
+**/
+struct AxisSegment
+{
+    arma::fmat channels; /// Grid samples x meas_index::total, ascending on the axis.
+    bool forward = true; /// The axis increases over the source samples.
+    u_int64_t first = 0; /// First source sample of the segment.
+    u_int64_t last = 0; /// Last source sample of the segment.
+};
+
+
 /**
  * The class parses and generates datasets that describe the dynamics of needle 
  * insertion into soft tissue.
@@ -17,15 +48,56 @@ public:
     AxialForceDataset(); 
     ~AxialForceDataset();
 
+    /**
+     * Copies and moves get their own lazy-loading state and rebind the 
+     * channel views to their own block. They must not race with the first 
+     * channel access on the source. Assignment is not available (the class 
+     * has const members).
+    **/
+    AxialForceDataset(const AxialForceDataset &other);
+    AxialForceDataset(AxialForceDataset &&other);
+
     /**
      * Parses the data file specified by data_id.
      * @param data_id The folder in which the data is located.
     **/
     void data_parsing(std::string data_id);
 
+    /**
+     * Enables the binary cache of processed datasets. When enabled, 
+     * data_parsing reloads share/<data_id>.cache if its content hash matches 
+     * the JSON and CSV inputs, and rewrites it otherwise.
+     * @param state Cache state.
+    **/
+    void set_cache_enabled(bool state) { m_cache_enabled = state; }
+
+    /**
+     * Selects how samples with repeated independent variable values are 
+     * collapsed (default: keep the last one).
+     * @param policy Aggregation policy.
+    **/
+    void set_duplicate_policy(ArmaExt::dup_policy policy) { m_dup_policy = policy; }
+
+    /**
+     * Selects the differentiator that estimates the velocity from the 
+     * displacement when the velocity is not measured (default: central 
+     * difference).
+     * @param diff Differentiator, e.g. a Savitzky-Golay one.
+    **/
+    void set_velocity_differentiator(const Differentiator &diff) { m_vel_diff = diff; }
+
+    /**
+     * Enables the metadata-only open mode. data_parsing then parses the JSON 
+     * sections only, and the measurement files are loaded and processed on 
+     * the first access to a channel getter.
+     * @param state Lazy loading state.
+    **/
+    void set_lazy_loading(bool state) { m_lazy_loading = state; }
+    bool is_meas_loaded(void) const { return m_meas_loaded.load(); }
+
     // Getters 
     u_int64_t get_dataset_size(void) { return m_dataset_size; }
-    std::string get_data_id(void) { return m_data_id; }
+    std::string get_data_id(void) const { return m_data_id; }
 
     // Source section getters
     std::string get_author_name(void) { return m_author_name; }
@@ -45,25 +117,130 @@ public:
     int get_tissue_layers_number(void) { return m_layers_num; }
     bool is_tissue_multilayer(void) {return m_multilayer; } 
     bool is_tissue_biological(void) {return m_biological; }
-    std::vector<std::vector<std::string>> get_tissue_description(void) { 
+    const std::vector<std::vector<std::string>> &get_tissue_description(void) const { 
         return m_tissue_desription; 
     } 
 
     // Measurement section getters
     int get_files_num(void) { return m_file_num; }
     float get_sampling_frequency(void) { return m_sampling_frequency; }
+    const std::vector<CsvStats> &get_csv_stats(void) const { 
+        ensure_measurements(); return m_csv_stats; 
+    }
+
+    /// Channels of the measurements, in column order of get_channels().
+    enum class meas_index
+    {
+        time, displ_x, vel_x, rot_x, force_x, total
+    };
+
+    /// JSON names of the channels, in meas_index order.
+    static constexpr const char *meas_names[5] = {"Time", "Displacement x", 
+        "Velocity x", "Rotation x", "Force x"};
+
+    /**
+     * Channel of a JSON name, meas_index::total if the name is unknown. 
+     * Evaluated at compile time for constant names.
+    **/
+    static constexpr meas_index meas_index_of(const char *name, int i=0) {
+        return (i == static_cast<int>(meas_index::total)) ? meas_index::total :
+            names_equal(name, meas_names[i]) ? static_cast<meas_index>(i) : 
+            meas_index_of(name, i + 1);
+    }
+
+    /**
+     * All processed channels in one contiguous column-major block, one 
+     * column per meas_index. Channels the dataset does not provide are zero 
+     * columns (see has_channel).
+    **/
+    const arma::fmat &get_channels(void) const { 
+        ensure_measurements(); return m_channels; 
+    }
+    bool has_channel(meas_index index) const {
+        ensure_measurements(); return (m_channels_mask >> static_cast<int>(index)) & 1;
+    }
+
+    // The channel getters alias the columns of the block (empty if missing)
+    const arma::fvec &get_time(void) const { return get_channel(meas_index::time); };
+    const arma::fvec &get_displ_x(void) const { return get_channel(meas_index::displ_x); }
+    const arma::fvec &get_vel_x(void) const { return get_channel(meas_index::vel_x); }
+    const arma::fvec &get_rot_x(void) const { return get_channel(meas_index::rot_x); }
+    const arma::fvec &get_force_x(void) const { return get_channel(meas_index::force_x); }
+    const arma::fvec &get_channel(meas_index index) const { 
+        ensure_measurements(); return m_channel[static_cast<int>(index)]; 
+    }
+
+    /**
+     * Value of a channel at the point q of an axis channel, e.g. the force at 
+     * a time or at a displacement. The resampled independent variable is 
+     * located in O(1), other non-decreasing channels by binary search. 
+     * Queries outside the axis range return the end values.
+     * @param channel Interpolated channel.
+     * @param axis Axis channel (throws std::invalid_argument if it is not 
+     * non-decreasing).
+     * @param q Query point.
+     * @param type Interpolation method.
+    **/
+    float get_value_at(meas_index channel, meas_index axis, float q, 
+        ChannelLookup::method type=ChannelLookup::method::linear) const;
+
+    /**
+     * Batched get_value_at. Ascending queries are located incrementally.
+    **/
+    void get_values_at(meas_index channel, meas_index axis, const arma::fvec &q, 
+        arma::fvec *values, 
+        ChannelLookup::method type=ChannelLookup::method::linear) const;
+
+    /**
+     * Resamples the channels on another channel, e.g. force vs depth on the 
+     * displacement. The recording is split into monotone segments (insertion 
+     * and retraction strokes) and every segment is resampled on the grid 
+     * k * spacing within its range, so datasets share the grid points. 
+     * Segments that hold no grid point are skipped.
+     * @param axis Axis channel.
+     * @param spacing Grid spacing on the axis.
+     * @param segments Receives the segments in recording order.
+     * @param min_excursion Reversal of the axis that starts a new segment; 
+     * smaller jitter stays in the segment (negative selects the spacing).
+    **/
+    void resample_on_axis(meas_index axis, float spacing, 
+        std::vector<AxisSegment> *segments, float min_excursion=-1.0f) const;
+
+    /**
+     * Non-owning spans over the channels. They stay valid until the dataset 
+     * is parsed again or destroyed.
+    **/
+    ChannelSpan<float> get_time_span(void) const { return get_time(); }
+    ChannelSpan<float> get_displ_x_span(void) const { return get_displ_x(); }
+    ChannelSpan<float> get_vel_x_span(void) const { return get_vel_x(); }
+    ChannelSpan<float> get_rot_x_span(void) const { return get_rot_x(); }
+    ChannelSpan<float> get_force_x_span(void) const { return get_force_x(); }
 
-    arma::fvec get_time(void) { return m_time; };
-    arma::fvec get_displ_x(void) { return m_displ_x; }
-    arma::fvec get_vel_x(void) { return m_vel_x; }
-    arma::fvec get_rot_x(void) { return m_rot_x; }
-    arma::fvec get_force_x(void) { return m_force_x; }
+    /**
+     * Armadillo vectors aliasing the channel memory (no copy is made). The 
+     * views must be used read-only and initialised directly from the getter, 
+     * since assigning them to an existing vector copies the data.
+    **/
+    arma::fvec get_time_view(void) const { return channel_view(get_time()); }
+    arma::fvec get_displ_x_view(void) const { return channel_view(get_displ_x()); }
+    arma::fvec get_vel_x_view(void) const { return channel_view(get_vel_x()); }
+    arma::fvec get_rot_x_view(void) const { return channel_view(get_rot_x()); }
+    arma::fvec get_force_x_view(void) const { return channel_view(get_force_x()); }
 
     // Constants
     bool is_displ_x_const(void) { return m_const_displ_x; }
     bool is_vel_x_const(void) { return m_const_vel_x; }
     bool is_rot_x_const(void) { return m_const_rot_x; }
 
+    // Processing stages (exposed for benchmarking)
+    static void resampling(arma::fmat *matr, float ts);
+    static void resampling(arma::fmat *matr, float ts, float t_end);
+    static void resampling(arma::fmat *matr, float ts, float t_start, float t_end);
+    static void central_diff_derivative(const arma::fvec &t_vec, 
+        const arma::fvec &x_vec, arma::fvec *u_vec);
+    static void central_diff_derivative(const arma::fvec &x_vec, float ts, 
+        arma::fvec *u_vec);
+
 public:
     const int bio_tissue_organ_index = 0; /// Index of organ definition for biological tissue.
     const int bio_tissue_animal_index = 1; /// Index of animal definition for biological tissue.
@@ -78,31 +255,106 @@ private:
     const std::string m_lib_rel_path = "./include/axial_force_dataset/";
     const std::string m_share_rel_dir = m_lib_rel_path + "share/";
 
-    // File handlers
-    std::ifstream m_file; /// File handler for std.
-    nlohmann::json m_j_file; /// File handler for json.
+    // Metadata SAX handler
+    class MetadataSax;
+
+    /// Value of a metadata field as reported by the SAX handler. Arrays keep 
+    /// their string and numeric items apart.
+    struct MetaValue
+    {
+        nlohmann::json::value_t type;
+        std::string str;
+        double num;
+        std::vector<std::string> items;
+        std::vector<float> values;
+        size_t size;
+
+        bool is_string(void) const { return type == nlohmann::json::value_t::string; }
+        bool is_number(void) const { 
+            return type == nlohmann::json::value_t::number_integer || 
+                type == nlohmann::json::value_t::number_unsigned || 
+                type == nlohmann::json::value_t::number_float; 
+        }
+        bool is_string_array(void) const { 
+            return type == nlohmann::json::value_t::array && items.size() == size; 
+        }
+        bool is_number_array(void) const { 
+            return type == nlohmann::json::value_t::array && values.size() == size; 
+        }
+    };
+
+    /// Required metadata fields, in the order of meta_key_names.
+    enum class meta_key
+    {
+        author, paper_title, year, doi, 
+        needle_diameter, tip_type, tip_angle, tip_sharpness, tip_lubrication, 
+        tissue_type, layers_number, 
+        sampling_frequency, ind_vars, dep_vars, files_names, constants, 
+        constants_values, total
+    };
+    static constexpr const char *meta_key_names[17] = {"Source/Author", 
+        "Source/Paper Title", "Source/Year", "Source/DOI", 
+        "Needle Characteristics/Needle Diameter", "Needle Characteristics/Tip Type", 
+        "Needle Characteristics/Tip Angle", "Needle Characteristics/Tip Sharpness", 
+        "Needle Characteristics/Tip Lubrication", "Tissue Characteristics/Tissue Type", 
+        "Tissue Characteristics/Layers Number", "Measurements/Sampling Frequency", 
+        "Measurements/Indepedent Variables", "Measurements/Depedent Variables", 
+        "Measurements/Files Names", "Measurements/Constants", 
+        "Measurements/Constants Values"};
+
+    // Required fields seen and the first mistyped one, reset by data_parsing
+    u_int32_t m_meta_seen = 0;
+    std::string m_meta_error;
+
+    // Cache
+    const std::string m_cache_ext = ".cache";
+    bool m_cache_enabled = false;
+
+    // Lazy loading
+    bool m_lazy_loading = false;
+    mutable std::atomic<bool> m_meas_loaded{false};
+    mutable std::mutex m_meas_mutex;
 
 private:
 
     // Parsing    
-    void parse_source_section(nlohmann::json &val);
-    void parse_needle_section(nlohmann::json &val);
-    void parse_tissue_section(nlohmann::json &val);
-    void parse_meas_section(nlohmann::json &val);
+    void parse_source_section(const std::string &field, const MetaValue &val);
+    void parse_needle_section(const std::string &field, const MetaValue &val);
+    void parse_tissue_section(const std::string &field, const MetaValue &val);
+    void parse_tissue_description(const std::string &field, const MetaValue &val);
+    void parse_meas_section(const std::string &field, const MetaValue &val);
+    bool check_meta(meta_key key, bool type_ok);
+    void finalize_metadata(void);
 
     // Measurements processing
     void measurements_processing(void);
-    void linear_extr_correction(arma::fmat *tbe_mat, arma::fmat *full_mat);
-    float linear_extrapolation(float tn, arma::fvec t_vec, arma::fvec f_vec);
-    void resampling(arma::fmat *matr, float ts);
-    void map_str_to_variable(std::string in_str, arma::fvec x);
-    void map_str_to_constant(std::string in_str);
-    arma::fvec central_diff_derivative(arma::fvec t_vec, arma::fvec x_vec);
+    void resolve_meas_ids(void);
+    void set_channel(meas_index index, const float *x, u_int64_t size);
+    void bind_channels(void);
+    void check_lookup(meas_index channel, meas_index axis) const;
+    static constexpr bool names_equal(const char *a, const char *b) {
+        return (*a == *b) && (*a == '\0' || names_equal(a + 1, b + 1));
+    }
+    static arma::fvec channel_view(const arma::fvec &vec);
+
+    // Cache
+    u_int64_t cache_key(const std::vector<std::vector<std::string>> &files);
+    bool load_cache(std::string cache_name, bool with_metadata=true);
+    bool save_cache(std::string cache_name);
+
+    // Copy and move
+    template <typename Other>
+    void assign_state(Other &&other);
+
+    // Lazy loading
+    void ensure_measurements(void) const;
+    void load_measurements(void);
+    std::pair<float, float> load_file(int index);
 
 private:
    
     /* Dataset size */
-    u_int64_t m_dataset_size;
+    u_int64_t m_dataset_size = 0;
 
     /* Dataset name */
     std::string m_data_id;
@@ -110,50 +362,56 @@ private:
     /* Source section variables */
     std::string m_author_name;
     std::string m_paper_title;
-    int m_year;
+    int m_year = 0;
     std::string m_doi;
 
     /* Needle characteristics section variables */
-    float m_needle_diameter;
+    float m_needle_diameter = 0.0f;
     std::string m_tip_type;
-    float m_tip_anlge;
+    float m_tip_anlge = 0.0f;
     std::string m_tip_sharpness; 
     std::string m_tip_lubrication;
 
     /* Tissue characteristics section variables */
     std::string m_tissue_type;
-    int m_layers_num;
-    bool m_multilayer;
-    bool m_biological;
+    int m_layers_num = 0;
+    bool m_multilayer = false;
+    bool m_biological = false;
     std::vector<std::vector<std::string>> m_tissue_desription;
+    std::map<std::string, std::vector<std::string>> m_tissue_fields;
     
 
     /* Measurement section variables */
-    enum class meas_index
-    {
-        time, displ_x, vel_x, rot_x, force_x, total
-    };
-
-    // Measurements types
-    std::string m_meas_ans[5] = {"Time", "Displacement x", "Velocity x", 
-        "Rotation x", "Force x"};
-    
     std::vector<std::vector<std::string>> m_meas_ind_vars;
     std::vector<std::vector<std::string>> m_meas_dep_vars;
     std::vector<std::vector<std::string>> m_meas_file;
     std::vector<std::vector<std::string>> m_meas_const;
     std::vector<std::vector<float>> m_meas_const_val;
 
-    int m_file_num;
-    float m_sampling_frequency;
-    u_int64_t m_meas_size;
+    // Channels of the variables of each file and of the constants, resolved
+    // once from the names above
+    std::vector<meas_index> m_meas_ind_ids;
+    std::vector<meas_index> m_meas_dep_ids;
+    std::vector<meas_index> m_meas_const_ids;
+
+    // Uniformly resampled axis (the independent variable shared by the files)
+    meas_index m_uniform_axis = meas_index::total;
+
+    int m_file_num = 0;
+    float m_sampling_frequency = 0.0f;
+    u_int64_t m_meas_size = 0;
 
     std::vector<arma::fmat> m_x_y;
-    arma::fvec m_time;
-    arma::fvec m_displ_x;
-    arma::fvec m_vel_x;
-    arma::fvec m_rot_x;
-    arma::fvec m_force_x;
+    std::vector<CsvStats> m_csv_stats;
+    ArmaExt::dup_policy m_dup_policy = ArmaExt::dup_policy::keep_last;
+    Differentiator m_vel_diff;
+
+    // Channel block (m_meas_size x meas_index::total), the presence bit of 
+    // each channel and per-channel vectors aliasing its columns
+    arma::fmat m_channels;
+    u_int32_t m_channels_mask = 0;
+    u_int32_t m_sorted_mask = 0;
+    std::vector<arma::fvec> m_channel;
 
     //Constants
     bool m_const_displ_x = false;
@@ -189,328 +447,1080 @@ protected:
 
 };
 
+constexpr const char *AxialForceDataset::meas_names[5];
+
+constexpr const char *AxialForceDataset::meta_key_names[17];
+
+// Every entry of the name table must match its meas_index
+static_assert(AxialForceDataset::meas_index_of("Time") == 
+    AxialForceDataset::meas_index::time &&
+    AxialForceDataset::meas_index_of("Displacement x") == 
+    AxialForceDataset::meas_index::displ_x &&
+    AxialForceDataset::meas_index_of("Velocity x") == 
+    AxialForceDataset::meas_index::vel_x &&
+    AxialForceDataset::meas_index_of("Rotation x") == 
+    AxialForceDataset::meas_index::rot_x &&
+    AxialForceDataset::meas_index_of("Force x") == 
+    AxialForceDataset::meas_index::force_x, "Channel names out of meas_index order");
+
 
 AxialForceDataset::AxialForceDataset()
 {
+    bind_channels();
 }
 
-/**************** Methods *****************/
+AxialForceDataset::AxialForceDataset(const AxialForceDataset &other)
+{
+    assign_state(other);
+}
 
-void AxialForceDataset::data_parsing(std::string data_id)
+AxialForceDataset::AxialForceDataset(AxialForceDataset &&other)
 {
-    // File name 
-    std::string file_name = m_share_rel_dir + data_id + "/" + data_id + ".json";
+    assign_state(std::move(other));
+    other.bind_channels();
+}
 
-    // Read json file
-    m_file = std::ifstream(file_name);
-    m_j_file = nlohmann::json::parse(m_file);
 
-    // Dataset file
-    m_dataset_size = m_j_file.size();
-    
-    // Parsing json file 
-    m_data_id = data_id;
-    auto val = m_j_file[data_id];
-    parse_source_section(val);
-    parse_needle_section(val);
-    parse_tissue_section(val);
-    parse_meas_section(val);
+/**
+ * SAX handler that maps the events of the requested dataset entry directly 
+ * to the typed members of AxialForceDataset. Entries of other datasets (e.g. 
+ * in the aggregate file) are skipped without being stored.
+**/
+class AxialForceDataset::MetadataSax : public nlohmann::json_sax<nlohmann::json>
+{
+public:
+    MetadataSax(AxialForceDataset *dataset, const std::string &data_id) : 
+        m_dataset(dataset), m_data_id(data_id) {};
+
+    bool null() override { return scalar(value_t::null, "", 0); }
+    bool boolean(bool val) override { 
+        return scalar(value_t::boolean, val ? "true" : "false", val); 
+    }
+    bool number_integer(number_integer_t val) override { 
+        return scalar(value_t::number_integer, std::to_string(val), val); 
+    }
+    bool number_unsigned(number_unsigned_t val) override { 
+        return scalar(value_t::number_unsigned, std::to_string(val), val); 
+    }
+    bool number_float(number_float_t val, const string_t &s) override { 
+        return scalar(value_t::number_float, s, val); 
+    }
+    bool string(string_t &val) override { return scalar(value_t::string, val, 0); }
+    bool binary(binary_t &) override { return scalar(value_t::binary, "", 0); }
+
+    bool start_object(std::size_t) override;
+    bool key(string_t &val) override;
+    bool end_object() override;
+    bool start_array(std::size_t) override;
+    bool end_array() override;
+
+    bool parse_error(std::size_t, const std::string &, 
+        const nlohmann::detail::exception &ex) override;
+
+    bool is_found(void) { return m_found; }
+    u_int64_t get_entries_num(void) { return m_entries_num; }
+    std::string get_error(void) { return m_error; }
+
+private:
+    struct Frame
+    {
+        bool array;
+        std::string key;
+    };
+
+    AxialForceDataset *m_dataset;
+    std::string m_data_id;
+
+    typedef nlohmann::json::value_t value_t;
+
+    std::vector<Frame> m_frames;
+    MetaValue m_array;
+
+    bool m_found = false;
+    u_int64_t m_entries_num = 0;
+    std::string m_error;
+
+    bool in_target(void);
+    bool in_array(void);
+    bool scalar(value_t type, const std::string &str, double num);
+    void dispatch(const MetaValue &val);
+};
+
+
+bool AxialForceDataset::MetadataSax::start_object(std::size_t)
+{
+    if (in_array()) { m_array.size++; }
+    m_frames.push_back({false, ""});
+    return true;
 }
 
 
-void AxialForceDataset::parse_source_section(nlohmann::json &val)
+bool AxialForceDataset::MetadataSax::key(string_t &val)
 {
-    /* Source section parsing */
-    m_author_name = val["Source"]["Author"];
-    m_paper_title = val["Source"]["Paper Title"];
-    m_year = val["Source"]["Year"];
-    m_doi = val["Source"]["DOI"]; 
+    m_frames.back().key = val;
+
+    if (m_frames.size() == 1)
+    {
+        m_entries_num++;
+        if (val == m_data_id) { m_found = true; }
+    }
+
+    return true;
 }
 
 
-void AxialForceDataset::parse_needle_section(nlohmann::json &val)
+bool AxialForceDataset::MetadataSax::end_object()
 {
-    /* Needle characteristics section parsing */
-    m_needle_diameter = val["Needle Characteristics"]["Needle Diameter"];
-    m_tip_type = val["Needle Characteristics"]["Tip Type"];
-    m_tip_anlge = val["Needle Characteristics"]["Tip Angle"]; 
-    m_tip_sharpness = val["Needle Characteristics"]["Tip Sharpness"];
-    m_tip_lubrication = val["Needle Characteristics"]["Tip Lubrication"];
+    m_frames.pop_back();
+    if (!in_array()) { dispatch(MetaValue{value_t::object, "", 0, {}, {}, 0}); }
+    return true;
 }
 
 
-void AxialForceDataset::parse_tissue_section(nlohmann::json &val)
+bool AxialForceDataset::MetadataSax::start_array(std::size_t)
 {
-    /* Tissue characteristics section parsing */
-    m_tissue_type = val["Tissue Characteristics"]["Tissue Type"];
-    m_layers_num = val["Tissue Characteristics"]["Layers Number"];
-    m_multilayer = (m_layers_num > 1);
+    // Items of nested arrays are not collected, so the outer array fails the 
+    // type checks
+    if (in_array()) { m_array.size++; }
+    else { m_array = MetaValue{value_t::array, "", 0, {}, {}, 0}; }
+
+    m_frames.push_back({true, ""});
+    return true;
+}
 
-    auto &tissue_descr = val["Tissue Characteristics"]["Tissue Description"];
 
-    const bool tissue_cond = m_tissue_type.compare(m_tissue_types_ans[0]) == 0;
-    
-    if (m_tissue_type.compare(m_tissue_types_ans[0]) == 0)
+bool AxialForceDataset::MetadataSax::end_array()
+{
+    m_frames.pop_back();
+    if (!in_array()) { dispatch(m_array); }
+    return true;
+}
+
+
+bool AxialForceDataset::MetadataSax::parse_error(std::size_t, 
+    const std::string &, const nlohmann::detail::exception &ex)
+{
+    m_error = ex.what();
+    return false;
+}
+
+
+bool AxialForceDataset::MetadataSax::in_target(void)
+{
+    return m_frames.size() >= 2 && m_frames[0].key == m_data_id;
+}
+
+
+bool AxialForceDataset::MetadataSax::in_array(void)
+{
+    return !m_frames.empty() && m_frames.back().array;
+}
+
+
+bool AxialForceDataset::MetadataSax::scalar(value_t type, const std::string &str, 
+    double num)
+{
+    // Array items (only of the outermost array, strings and numbers apart)
+    if (in_array())
     {
-        m_biological = true;
-        m_tissue_desription.push_back(tissue_descr.at("Organ/Location"));
-        m_tissue_desription.push_back(tissue_descr.at("Animal"));
-        m_tissue_desription.push_back(tissue_descr.at("State"));
+        m_array.size++;
+        if (m_frames.size() < 2 || m_frames[m_frames.size() - 2].array) { return true; }
+
+        if (type == value_t::string) { m_array.items.push_back(str); }
+        else if (type == value_t::number_integer || type == value_t::number_unsigned || 
+            type == value_t::number_float) { m_array.values.push_back(num); }
+        return true;
     }
 
-    else {
-        m_biological = false;
-        m_tissue_desription.push_back(tissue_descr.at("Name"));
-        m_tissue_desription.push_back(tissue_descr.at("Components"));
-        m_tissue_desription.push_back(tissue_descr.at("Concentration"));
+    dispatch(MetaValue{type, str, num, {}, {}, 0});
+    return true;
+}
+
+
+/**
+ * Hands a complete value to the section handler of its key. The frames hold 
+ * the keys of the dataset entry, the section and (for the tissue 
+ * description) the description field.
+**/
+void AxialForceDataset::MetadataSax::dispatch(const MetaValue &val)
+{
+    if (!in_target()) { return; }
+
+    const std::string &section = m_frames[1].key;
+
+    if (m_frames.size() == 3)
+    {
+        const std::string &field = m_frames[2].key;
+
+        if (section == "Source") { m_dataset->parse_source_section(field, val); }
+        else if (section == "Needle Characteristics") 
+        { 
+            m_dataset->parse_needle_section(field, val); 
+        }
+        else if (section == "Tissue Characteristics") 
+        { 
+            m_dataset->parse_tissue_section(field, val); 
+        }
+        else if (section == "Measurements") 
+        { 
+            m_dataset->parse_meas_section(field, val); 
+        }
+    }
+    else if (m_frames.size() == 4 && section == "Tissue Characteristics" && 
+        m_frames[2].key == "Tissue Description")
+    {
+        m_dataset->parse_tissue_description(m_frames[3].key, val);
     }
 }
 
+/**************** Methods *****************/
 
-void AxialForceDataset::parse_meas_section(nlohmann::json &val)
+void AxialForceDataset::data_parsing(std::string data_id)
 {
+    // File name 
+    std::string file_name = m_share_rel_dir + data_id + "/" + data_id + ".json";
+    std::string cache_name = m_share_rel_dir + data_id + m_cache_ext;
 
-    auto &meas_handle = val["Measurements"];
-    m_sampling_frequency = meas_handle.at("Sampling Frequency");
-    m_meas_ind_vars.push_back(meas_handle.at("Indepedent Variables"));
-    m_meas_dep_vars.push_back(meas_handle.at("Depedent Variables"));
-    m_meas_file.push_back(meas_handle.at("Files Names"));
-    m_file_num = m_meas_file[0].size();
-    m_meas_const.push_back(meas_handle.at("Constants"));
-    m_meas_const_val.push_back(meas_handle.at("Constants Values"));
+    // Warm start from the cache
+    m_data_id = data_id;
+    m_meas_loaded = false;
+    if (!m_lazy_loading && m_cache_enabled && load_cache(cache_name))
+    {
+        m_meas_loaded = true;
+        return; 
+    }
 
-    for(int i = 0; i < m_file_num; i++)
+    m_tissue_desription.clear(); m_tissue_fields.clear(); m_meas_ind_vars.clear(); 
+    m_meas_dep_vars.clear(); m_meas_file.clear(); m_meas_const.clear();
+    m_meas_const_val.clear(); m_x_y.clear(); m_csv_stats.clear();
+    m_const_displ_x = false; m_const_vel_x = false; m_const_rot_x = false;
+    m_meta_seen = 0; m_meta_error.clear();
+
+    // Parsing json file (SAX events are mapped straight to the members)
+    std::ifstream file(file_name);
+    MetadataSax sax(this, data_id);
+
+    if (!nlohmann::json::sax_parse(file, &sax))
+    {
+        throw std::runtime_error(file_name + ": " + sax.get_error());
+    }
+    if (!sax.is_found())
     {
-        std::string file = m_share_rel_dir + m_data_id + "/" + m_meas_file[0][i];
-        arma::fmat x_y_data;
-        x_y_data.load(file, arma::csv_ascii);
-        ArmaExt::sortrows<arma::fmat>(&x_y_data, true);
-        m_x_y.push_back(x_y_data);
+        throw std::runtime_error(file_name + ": no \"" + data_id + "\" entry");
     }
 
-    measurements_processing();
+    // Dataset file
+    m_dataset_size = sax.get_entries_num();
+    finalize_metadata();
+
+    // Measurements are materialised on first access in lazy mode
+    if (!m_lazy_loading) { ensure_measurements(); }
 }
 
 
-void AxialForceDataset::measurements_processing(void)
+/**
+ * Loads and processes the measurement files once. Safe to call concurrently 
+ * from several threads.
+**/
+void AxialForceDataset::ensure_measurements(void) const
+{
+    if (m_meas_loaded.load(std::memory_order_acquire)) { return; }
+
+    std::lock_guard<std::mutex> lock(m_meas_mutex);
+    if (m_meas_loaded.load(std::memory_order_relaxed)) { return; }
+
+    const_cast<AxialForceDataset *>(this)->load_measurements();
+    m_meas_loaded.store(true, std::memory_order_release);
+}
+
+
+void AxialForceDataset::load_measurements(void)
 {
-    arma::fmat x_sort(m_file_num, 2);
+    // In eager mode the cache has already been checked by data_parsing
+    std::string cache_name = m_share_rel_dir + m_data_id + m_cache_ext;
+    if (m_cache_enabled && m_lazy_loading && load_cache(cache_name, false)) 
+    { 
+        return; 
+    }
+
+    m_x_y.assign(m_file_num, arma::fmat()); 
+    m_csv_stats.assign(m_file_num, CsvStats());
+
+    // Every file is loaded, sorted and resampled on its own thread. The 
+    // resampling grid is shared by all the files: it spans from the earliest 
+    // start to the latest end of the files (the shorter ones are held before 
+    // their first sample and extrapolated past their last), and is published 
+    // once every file is sorted.
+    // (The promise is declared last so that, on unwinding, it is broken 
+    // before the file threads are joined.)
+    typedef std::pair<float, float> time_range;
+    const float sampling_period = 1.0f / m_sampling_frequency;
+    std::vector<std::future<void>> file_done;
+    std::vector<std::future<time_range>> file_range;
+    std::promise<time_range> grid_promise;
+    std::shared_future<time_range> grid = grid_promise.get_future().share();
 
     for(int i = 0; i < m_file_num; i++)
     {
-        arma::fmat x_y_mat =  m_x_y.at(i); arma::fvec x_vec = x_y_mat.col(0);
-        x_sort.at(i, 0) = x_vec.back(); x_sort.at(i, 1) = (float) i; 
+        auto sorted = std::make_shared<std::promise<time_range>>();
+        file_range.push_back(sorted->get_future());
+
+        file_done.push_back(std::async(std::launch::async, 
+            [this, i, sorted, grid, sampling_period]() {
+                try { sorted->set_value(load_file(i)); }
+                catch (...) { sorted->set_exception(std::current_exception()); return; }
+
+                time_range range;
+                try { range = grid.get(); } catch (...) { return; }
+                resampling(&m_x_y.at(i), sampling_period, range.first, range.second);
+            }));
     }
-    ArmaExt::sortrows<arma::fmat>(&x_sort, true);
-    
-    float sampling_period = 1.0f / m_sampling_frequency;
-    int index_max = (float) x_sort.at(x_sort.n_rows-1, 1);
 
-    for(int i = 0; i < m_file_num - 1; i++)
+    time_range range(std::numeric_limits<float>::infinity(), 
+        -std::numeric_limits<float>::infinity());
+    std::exception_ptr error;
+
+    for(int i = 0; i < m_file_num; i++)
     {
-        int index = (float) x_sort.at(i, 1);
-        linear_extr_correction(&m_x_y.at(index), &m_x_y.at(index_max));
-        resampling(&m_x_y.at(index), sampling_period);
+        try 
+        { 
+            time_range file = file_range[i].get();
+            range.first = std::min(range.first, file.first);
+            range.second = std::max(range.second, file.second);
+        }
+        catch (...) { if (!error) { error = std::current_exception(); } }
     }
-    resampling(&m_x_y.at(index_max), sampling_period);
 
-    // Size of measuremets 
-    m_meas_size = (m_x_y.at(0)).n_rows;
+    if (error) { grid_promise.set_exception(error); }
+    else { grid_promise.set_value(range); }
 
-    for(int i = 0; i < m_file_num; i++)
+    for(int i = 0; i < m_file_num; i++) { file_done[i].get(); }
+    if (error) { std::rethrow_exception(error); }
+
+    measurements_processing();
+
+    if (m_cache_enabled) { save_cache(cache_name); }
+}
+
+
+/**
+ * Loads, sorts and collapses the duplicates of the measurement file index.
+ * @return First and last values of the independent variable.
+**/
+std::pair<float, float> AxialForceDataset::load_file(int index)
+{
+    std::string file = m_share_rel_dir + m_data_id + "/" + m_meas_file[0][index];
+    arma::fmat &x_y_data = m_x_y.at(index);
+
+    if (!CsvReader::load<arma::fmat>(file, &x_y_data, &m_csv_stats.at(index)))
+    {
+        throw std::runtime_error(file + ": cannot be read");
+    }
+    if (x_y_data.n_rows == 0 || x_y_data.n_cols < 2)
     {
-        arma::fmat x_y_mat = m_x_y.at(i); 
-        
-        arma::fvec x_vec = x_y_mat.col(0);
-        map_str_to_variable(m_meas_ind_vars[0][i], x_vec);
+        throw std::runtime_error(file + ": no measurements");
+    }
+
+    ArmaExt::sortrows<arma::fmat>(&x_y_data, true, m_dup_policy);
+    return std::make_pair(x_y_data.at(0, 0), x_y_data.at(x_y_data.n_rows - 1, 0));
+}
 
-        arma::fvec y_vec = x_y_mat.col(1);
-        map_str_to_variable(m_meas_dep_vars[0][i], y_vec);
+
+void AxialForceDataset::parse_source_section(const std::string &field, 
+    const MetaValue &val)
+{
+    /* Source section parsing */
+    const bool str = val.is_string(); const bool num = val.is_number();
+
+    if (field == "Author" && check_meta(meta_key::author, str)) { m_author_name = val.str; }
+    else if (field == "Paper Title" && check_meta(meta_key::paper_title, str)) 
+    { 
+        m_paper_title = val.str; 
     }
+    else if (field == "Year" && check_meta(meta_key::year, num)) { m_year = val.num; }
+    else if (field == "DOI" && check_meta(meta_key::doi, str)) { m_doi = val.str; }
+}
 
-    // Constants
-    int const_size = m_meas_const[0].size();
-    bool const_vel = false;
-    
-    for (int i = 0; i < const_size; i++)
+
+void AxialForceDataset::parse_needle_section(const std::string &field, 
+    const MetaValue &val)
+{
+    /* Needle characteristics section parsing */
+    const bool str = val.is_string(); const bool num = val.is_number();
+
+    if (field == "Needle Diameter" && check_meta(meta_key::needle_diameter, num)) 
+    { 
+        m_needle_diameter = val.num; 
+    }
+    else if (field == "Tip Type" && check_meta(meta_key::tip_type, str)) 
+    { 
+        m_tip_type = val.str; 
+    }
+    else if (field == "Tip Angle" && check_meta(meta_key::tip_angle, num)) 
+    { 
+        m_tip_anlge = val.num; 
+    }
+    else if (field == "Tip Sharpness" && check_meta(meta_key::tip_sharpness, str)) 
+    { 
+        m_tip_sharpness = val.str; 
+    }
+    else if (field == "Tip Lubrication" && check_meta(meta_key::tip_lubrication, str)) 
+    { 
+        m_tip_lubrication = val.str; 
+    }
+}
+
+
+void AxialForceDataset::parse_tissue_section(const std::string &field, 
+    const MetaValue &val)
+{
+    /* Tissue characteristics section parsing */
+    if (field == "Tissue Type" && check_meta(meta_key::tissue_type, val.is_string())) 
+    { 
+        m_tissue_type = val.str; 
+    }
+    else if (field == "Layers Number" && check_meta(meta_key::layers_number, val.is_number())) 
+    { 
+        m_layers_num = val.num; 
+    }
+}
+
+
+void AxialForceDataset::parse_tissue_description(const std::string &field, 
+    const MetaValue &val)
+{
+    if (val.is_string_array()) { m_tissue_fields[field] = val.items; }
+    else if (m_meta_error.empty()) 
+    { 
+        m_meta_error = "\"Tissue Description/" + field + "\" is not an array of strings"; 
+    }
+}
+
+
+void AxialForceDataset::parse_meas_section(const std::string &field, 
+    const MetaValue &val)
+{
+    /* Measurements section parsing */
+    const bool strs = val.is_string_array();
+
+    if (field == "Sampling Frequency" && 
+        check_meta(meta_key::sampling_frequency, val.is_number())) 
+    { 
+        m_sampling_frequency = val.num; 
+    }
+    else if (field == "Indepedent Variables" && check_meta(meta_key::ind_vars, strs)) 
+    { 
+        m_meas_ind_vars.push_back(val.items); 
+    }
+    else if (field == "Depedent Variables" && check_meta(meta_key::dep_vars, strs)) 
+    { 
+        m_meas_dep_vars.push_back(val.items); 
+    }
+    else if (field == "Files Names" && check_meta(meta_key::files_names, strs)) 
+    { 
+        m_meas_file.push_back(val.items); 
+    }
+    else if (field == "Constants" && check_meta(meta_key::constants, strs)) 
+    { 
+        m_meas_const.push_back(val.items); 
+    }
+    else if (field == "Constants Values" && 
+        check_meta(meta_key::constants_values, val.is_number_array())) 
+    { 
+        m_meas_const_val.push_back(val.values); 
+    }
+}
+
+
+/**
+ * Marks a required field as seen and records it as the first mistyped field 
+ * when its value has the wrong type.
+ * @return True if the value can be stored.
+*/
+bool AxialForceDataset::check_meta(meta_key key, bool type_ok)
+{
+    m_meta_seen |= 1u << static_cast<int>(key);
+
+    if (!type_ok && m_meta_error.empty())
     {
-        arma::fvec const_vec = arma::zeros<arma::fvec>(m_meas_size); 
-        const_vec.fill(m_meas_const_val[0][i]);
-        map_str_to_variable(m_meas_const[0][i], const_vec);
-        map_str_to_constant(m_meas_const[0][i]);
+        m_meta_error = std::string("\"") + meta_key_names[static_cast<int>(key)] + 
+            "\" has the wrong type";
     }
+    return type_ok;
+}
 
-    // Estimate time
-    std::string time_str = m_meas_ans[static_cast<int>(meas_index::time)];
-    
-    if (m_meas_ind_vars[0][0].compare(time_str) != 0 && m_const_vel_x)
+
+/**
+ * Checks the parsed metadata (as the typed JSON accessors did) and derives 
+ * the dependent members. Throws std::out_of_range for missing fields and 
+ * std::invalid_argument for mistyped or inconsistent ones.
+*/
+void AxialForceDataset::finalize_metadata(void)
+{
+    if (!m_meta_error.empty())
     {
-       arma::fmat time_vec = m_displ_x /  m_vel_x[0];
-        map_str_to_variable(time_str, time_vec);
+        throw std::invalid_argument(m_data_id + ": " + m_meta_error);
     }
 
-    // Estimate velocity (see if velocity belongs to the depedent variables)
-    std::string vel_x_str = m_meas_ans[static_cast<int>(meas_index::vel_x)];
-    int16_t vel_x_dep = 0;
+    for (int i = 0; i < static_cast<int>(meta_key::total); i++)
+    {
+        if (!((m_meta_seen >> i) & 1))
+        {
+            throw std::out_of_range(m_data_id + ": missing \"" + meta_key_names[i] + "\"");
+        }
+    }
 
-    for(int i = 0; i < m_file_num; i++)
+    m_multilayer = (m_layers_num > 1);
+
+    // Tissue description ordered by the tissue type
+    const char *bio_fields[3] = {"Organ/Location", "Animal", "State"};
+    const char *art_fields[3] = {"Name", "Components", "Concentration"};
+
+    m_biological = (m_tissue_type.compare(m_tissue_types_ans[0]) == 0);
+    const char **fields = (m_biological) ? bio_fields : art_fields;
+
+    for (int i = 0; i < 3; i++)
     {
-        if(!vel_x_str.compare(m_meas_dep_vars[0][i])) { vel_x_dep |= (1 << i);}
+        auto field = m_tissue_fields.find(fields[i]);
+        if (field == m_tissue_fields.end())
+        {
+            throw std::out_of_range(m_data_id + ": missing \"Tissue Description/" + 
+                fields[i] + "\"");
+        }
+        m_tissue_desription.push_back(field->second);
     }
+    m_tissue_fields.clear();
+
+    // Every file has one independent and one dependent variable, and every 
+    // constant a value (extra values are ignored)
+    m_file_num = m_meas_file[0].size();
 
-    if(!(m_meas_ind_vars[0][0].compare(time_str)) && (vel_x_dep == 0) 
-        && !m_const_vel_x)
+    if (!(m_sampling_frequency > 0.0f))
+    {
+        throw std::invalid_argument(m_data_id + ": \"Sampling Frequency\" is not positive");
+    }
+    if (m_meas_ind_vars[0].size() != m_meas_file[0].size() || 
+        m_meas_dep_vars[0].size() != m_meas_file[0].size())
     {
-        arma::fvec vel_x_vec = central_diff_derivative(m_time, m_displ_x);
-        map_str_to_variable(vel_x_str, vel_x_vec);
+        throw std::invalid_argument(m_data_id + ": the variables do not match the files");
     }
+    if (m_meas_const_val[0].size() < m_meas_const[0].size())
+    {
+        throw std::invalid_argument(m_data_id + ": missing constants values");
+    }
+
+    resolve_meas_ids();
 }
 
 
-void AxialForceDataset::map_str_to_variable(std::string in_str, arma::fvec x)
+/**
+ * Maps the channel names of the measurement section to meas_index, so the 
+ * processing does no string work, and flags the constant channels.
+**/
+void AxialForceDataset::resolve_meas_ids(void)
 {
-    if (in_str.compare(m_meas_ans[static_cast<int>(meas_index::time)]) == 0)
+    m_meas_ind_ids.clear(); m_meas_dep_ids.clear(); m_meas_const_ids.clear();
+
+    for (size_t i = 0; i < m_meas_ind_vars[0].size(); i++)
     {
-        m_time = x;
+        m_meas_ind_ids.push_back(meas_index_of(m_meas_ind_vars[0][i].c_str()));
     }
-
-    if(in_str.compare(m_meas_ans[static_cast<int>(meas_index::displ_x)]) == 0)
+    for (size_t i = 0; i < m_meas_dep_vars[0].size(); i++)
     {
-        m_displ_x = x;
+        m_meas_dep_ids.push_back(meas_index_of(m_meas_dep_vars[0][i].c_str()));
     }
-
-    if(in_str.compare(m_meas_ans[static_cast<int>(meas_index::vel_x)]) == 0)
+    for (size_t i = 0; i < m_meas_const[0].size(); i++)
     {
-        m_vel_x = x;
+        m_meas_const_ids.push_back(meas_index_of(m_meas_const[0][i].c_str()));
     }
 
-    if(in_str.compare(m_meas_ans[static_cast<int>(meas_index::rot_x)]) == 0)
+    m_uniform_axis = m_meas_ind_ids.empty() ? meas_index::total : m_meas_ind_ids[0];
+    for (size_t i = 1; i < m_meas_ind_ids.size(); i++)
     {
-        m_rot_x = x;
+        if (m_meas_ind_ids[i] != m_uniform_axis) { m_uniform_axis = meas_index::total; }
     }
 
-    if(in_str.compare(m_meas_ans[static_cast<int>(meas_index::force_x)]) == 0)
+    for (size_t i = 0; i < m_meas_const_ids.size(); i++)
     {
-        m_force_x = x;
+        if (m_meas_const_ids[i] == meas_index::displ_x) { m_const_displ_x = true; }
+        if (m_meas_const_ids[i] == meas_index::vel_x) { m_const_vel_x = true; }
+        if (m_meas_const_ids[i] == meas_index::rot_x) { m_const_rot_x = true; }
     }
-    
 }
 
 
-void AxialForceDataset::map_str_to_constant(std::string in_str)
+void AxialForceDataset::measurements_processing(void)
 {
+    // The files are resampled on a common grid by load_measurements
+    float sampling_period = 1.0f / m_sampling_frequency;
 
-    if(in_str.compare(m_meas_ans[static_cast<int>(meas_index::displ_x)]) == 0)
+    // Size of measuremets (every file spans the same grid, the shortest one 
+    // is taken so that every channel fills a column)
+    m_meas_size = (m_x_y.at(0)).n_rows;
+    for(int i = 1; i < m_file_num; i++)
     {
-        m_const_displ_x = true;
+        m_meas_size = std::min<u_int64_t>(m_meas_size, m_x_y.at(i).n_rows);
     }
 
-    if(in_str.compare(m_meas_ans[static_cast<int>(meas_index::vel_x)]) == 0)
+    m_channels.zeros(m_meas_size, static_cast<int>(meas_index::total));
+    m_channels_mask = 0;
+
+    for(int i = 0; i < m_file_num; i++)
     {
-        m_const_vel_x = true;
+        const arma::fmat &x_y_mat = m_x_y.at(i); 
+        set_channel(m_meas_ind_ids[i], x_y_mat.colptr(0), x_y_mat.n_rows);
+        set_channel(m_meas_dep_ids[i], x_y_mat.colptr(1), x_y_mat.n_rows);
     }
 
-    if(in_str.compare(m_meas_ans[static_cast<int>(meas_index::rot_x)]) == 0)
+    // The raw files are no longer needed
+    std::vector<arma::fmat>().swap(m_x_y);
+
+    // Constants
+    int const_size = m_meas_const_ids.size();
+    
+    for (int i = 0; i < const_size; i++)
     {
-        m_const_rot_x = true;
+        meas_index index = m_meas_const_ids[i];
+        if (index == meas_index::total) { continue; }
+
+        float *col = m_channels.colptr(static_cast<int>(index));
+        std::fill(col, col + m_meas_size, m_meas_const_val[0][i]);
+        m_channels_mask |= 1u << static_cast<int>(index);
     }
+
+    const int time_col = static_cast<int>(meas_index::time);
+    const int displ_x_col = static_cast<int>(meas_index::displ_x);
+    const int vel_x_col = static_cast<int>(meas_index::vel_x);
+
+    // Estimate time
+    const bool time_ind = (m_meas_ind_ids[0] == meas_index::time);
     
+    if (!time_ind && m_const_vel_x)
+    {
+        const float *displ_x = m_channels.colptr(displ_x_col);
+        const float vel_x = m_channels.at(0, vel_x_col);
+        float *time = m_channels.colptr(time_col);
+
+        for (u_int64_t i = 0; i < m_meas_size; i++) { time[i] = displ_x[i] / vel_x; }
+        m_channels_mask |= 1u << time_col;
+    }
+
+    // Estimate velocity (see if velocity belongs to the depedent variables)
+    const bool vel_x_dep = std::find(m_meas_dep_ids.begin(), m_meas_dep_ids.end(), 
+        meas_index::vel_x) != m_meas_dep_ids.end();
+
+    if(time_ind && !vel_x_dep && !m_const_vel_x)
+    {
+        // The measurements are resampled, so the time grid is uniform
+        m_vel_diff.apply(m_channels.colptr(displ_x_col), sampling_period, 
+            m_channels.colptr(vel_x_col), m_meas_size);
+        m_channels_mask |= 1u << vel_x_col;
+    }
+
+    bind_channels();
 }
 
 
-void AxialForceDataset::linear_extr_correction(arma::fmat *tbe_mat, 
-    arma::fmat *full_mat)
+/**
+ * Copies the first m_meas_size samples of x into the column of the channel. 
+ * The resampled files start at the same time, so their samples are aligned.
+**/
+void AxialForceDataset::set_channel(meas_index index, const float *x, 
+    u_int64_t size)
 {
-    arma::fvec x_tbe = tbe_mat->col(0); arma::fvec y_tbe = tbe_mat->col(1);
-
-    arma::fvec x_full = full_mat->col(0); arma::fvec y_full = full_mat->col(1);
+    if (index == meas_index::total) { return; }
 
-    float extra_x = x_full.back();
-    float extra_y = linear_extrapolation(extra_x, x_tbe, y_tbe);
-    arma::fvec push_vec = {extra_x, extra_y};
-    tbe_mat->insert_rows(tbe_mat->n_rows, push_vec.t());
+    const int col = static_cast<int>(index);
+    const u_int64_t count = std::min<u_int64_t>(size, m_meas_size);
+    std::copy(x, x + count, m_channels.colptr(col));
+    m_channels_mask |= 1u << col;
 }
 
 
-float AxialForceDataset::linear_extrapolation(float tn, arma::fvec t_vec, 
-    arma::fvec f_vec)
+/**
+ * Rebuilds the per-channel vectors as aliases of the columns of the block, 
+ * and flags the non-decreasing channels (usable as lookup axes). Must be 
+ * called whenever the block is reallocated.
+**/
+void AxialForceDataset::bind_channels(void)
 {
-    float tc = arma::as_scalar(t_vec.row(t_vec.n_rows - 1));
-    float to = arma::as_scalar(t_vec.row(t_vec.n_rows - 2));
+    std::vector<arma::fvec> channel;
+    channel.reserve(static_cast<int>(meas_index::total));
+    m_sorted_mask = 0;
 
-    float fc = arma::as_scalar(f_vec.row(f_vec.n_rows - 1));
-    float fo = arma::as_scalar(f_vec.row(f_vec.n_rows - 2));
+    for (int i = 0; i < static_cast<int>(meas_index::total); i++)
+    {
+        if ((m_channels_mask >> i) & 1)
+        {
+            const float *col = m_channels.colptr(i);
+            channel.emplace_back(const_cast<float *>(col), m_channels.n_rows, false, true);
+            if (std::is_sorted(col, col + m_channels.n_rows)) { m_sorted_mask |= 1u << i; }
+        }
+        else { channel.emplace_back(); }
+    }
 
-    return (fc + ((fc - fo) / (tc - to)) * (tn - to));
+    m_channel.swap(channel);
 }
 
 
-void AxialForceDataset::resampling(arma::fmat *matr, float ts)
+float AxialForceDataset::get_value_at(meas_index channel, meas_index axis, 
+    float q, ChannelLookup::method type) const
 {
-    arma::fvec t = (*matr).col(0);
-    arma::fvec tu = arma::regspace<arma::fvec>(t.front(), ts, t.back());
-    arma::fmat mat_u(tu.n_rows, (*matr).n_cols); mat_u.zeros();
-    mat_u(0, arma::span::all) = (*matr)(0, arma::span::all);
+    check_lookup(channel, axis);
 
-    for (int64_t i = 1; i < mat_u.n_rows; i++)
-    {   
-        arma::uvec q1 =  arma::find(t < tu(i));
-        arma::uvec q2 = arma::find(t > tu(i));
+    const arma::uword n = m_channels.n_rows;
+    const float *a = m_channels.colptr(static_cast<int>(axis));
+    const float *y = m_channels.colptr(static_cast<int>(channel));
 
-        // Indices that tu(i) belongs in
-        int64_t index1 = q1.back(); int64_t index2 = q2.front();
+    const arma::uword i = (axis == m_uniform_axis) ? 
+        ChannelLookup::locate_uniform<float>(a, n, m_sampling_frequency, q) :
+        ChannelLookup::locate_sorted<float>(a, n, q);
 
-        // Times that tu(i) belongs in
-        float t1 = t(index1); float t2 = t(index2);
+    return ChannelLookup::interpolate<float>(a, y, n, i, q, type);
+}
+
+void AxialForceDataset::get_values_at(meas_index channel, meas_index axis, 
+    const arma::fvec &q, arma::fvec *values, ChannelLookup::method type) const
+{
+    check_lookup(channel, axis);
 
-        // Corresponding values for t1 and t2
-        arma::fvec a1 = (*matr)(index1, arma::span(1, matr->n_cols - 1));
-        arma::fvec a2 = (*matr)(index2, arma::span(1, matr->n_cols - 1));
+    const arma::uword n = m_channels.n_rows;
+    const float *a = m_channels.colptr(static_cast<int>(axis));
+    const float *y = m_channels.colptr(static_cast<int>(channel));
+    const bool uniform = (axis == m_uniform_axis);
 
-        // Interpolation
-        arma::fvec a = a2 - ((a2 - a1) / (t2 - t1)) * (t2 - tu(i));
+    arma::fvec out(q.n_elem);
+    arma::uword i = 0;
 
-        mat_u(i, 0) = tu(i);
-        mat_u(i, arma::span(1, mat_u.n_cols - 1)) = a;
+    for (arma::uword k = 0; k < q.n_elem; k++)
+    {
+        i = uniform ? ChannelLookup::locate_uniform<float>(a, n, m_sampling_frequency, q[k]) :
+            ChannelLookup::locate_sorted<float>(a, n, q[k], i);
+        out[k] = ChannelLookup::interpolate<float>(a, y, n, i, q[k], type);
     }
-    
-    (*matr) = mat_u;
+
+    values->steal_mem(out);
 }
 
-arma::fvec AxialForceDataset::central_diff_derivative(arma::fvec t_vec, 
-    arma::fvec x_vec)
+
+/**
+ * Each segment is gathered with the axis as first column (reversed when the 
+ * axis decreases), sorted with its repeated axis values averaged, and passed 
+ * through the linear-time resampler.
+*/
+void AxialForceDataset::resample_on_axis(meas_index axis, float spacing, 
+    std::vector<AxisSegment> *segments, float min_excursion) const
 {
-    arma::fvec u_vec(t_vec.n_rows); u_vec.fill(0);
+    ensure_measurements();
+    segments->clear();
 
-    for (u_int64_t i = 0; i < t_vec.n_rows; i++)
+    if (!has_channel(axis) || !(spacing > 0.0f))
     {
-        float to, tn, xo, xn;
+        throw std::invalid_argument("Resampling on a missing axis or with a "
+            "non-positive spacing in " + m_data_id);
+    }
 
-        if (i == 0)
-        {
-            to = 0.0; tn = t_vec(i + 1);
-            xo = 0.0; xn = x_vec(i + 1);
-        }
-        else if (i == t_vec.n_rows - 1)
+    // Column order of the gathered segments: axis first
+    const int total = static_cast<int>(meas_index::total);
+    std::vector<int> order(1, static_cast<int>(axis));
+    for (int j = 0; j < total; j++) { if (j != order[0]) { order.push_back(j); } }
+
+    const float *a = m_channels.colptr(order[0]);
+    std::vector<std::pair<arma::uword, arma::uword>> runs = ArmaExt::monotone_runs<float>(
+        a, m_channels.n_rows, (min_excursion < 0.0f) ? spacing : min_excursion);
+
+    for (size_t r = 0; r < runs.size(); r++)
+    {
+        const arma::uword first = runs[r].first; const arma::uword last = runs[r].second;
+        const bool forward = a[last] >= a[first];
+
+        const arma::uword len = last - first + 1;
+        arma::fmat seg(len, total);
+        for (int j = 0; j < total; j++)
         {
-            to = t_vec(i); tn = 0.0;
-            xo = x_vec(i); xn = 0.0;
+            const float *src = m_channels.colptr(order[j]) + first;
+            float *dst = seg.colptr(j);
+            if (forward) { std::copy(src, src + len, dst); }
+            else { std::reverse_copy(src, src + len, dst); }
         }
-        else
+
+        // Jitter within the hysteresis is sorted out (a no-op for monotone runs)
+        ArmaExt::sortrows<arma::fmat>(&seg, true, ArmaExt::dup_policy::mean);
+
+        // Grid indices within the range, tolerant to the rounding of the ratios
+        const float k_lo = std::ceil(seg.at(0, 0) / spacing - 1e-4f);
+        const float k_hi = std::floor(seg.at(seg.n_rows - 1, 0) / spacing + 1e-4f);
+        if (k_lo > k_hi) { continue; }
+
+        ArmaExt::resampling<arma::fmat>(&seg, spacing, k_lo * spacing, 
+            (k_hi + 0.5f) * spacing);
+
+        AxisSegment out;
+        out.channels.set_size(seg.n_rows, total);
+        for (int j = 0; j < total; j++)
         {
-            to = t_vec(i - 1); tn = t_vec(i + 1);
-            xo = x_vec(i - 1); xn = x_vec(i + 1);
+            std::copy(seg.colptr(j), seg.colptr(j) + seg.n_rows, 
+                out.channels.colptr(order[j]));
         }
+        out.forward = forward; out.first = first; out.last = last;
 
-        float step = tn - to; 
-        if (step == 0) { step = 10e-6; }
-        u_vec(i) = (xn - xo) / (2 * step);
+        segments->push_back(std::move(out));
     }
+}
+
+
+void AxialForceDataset::check_lookup(meas_index channel, meas_index axis) const
+{
+    ensure_measurements();
 
-    return u_vec;
+    if (!has_channel(channel) || !has_channel(axis) || m_channels.n_rows == 0)
+    {
+        throw std::invalid_argument("Lookup on a channel missing in " + m_data_id);
+    }
+    if (axis != m_uniform_axis && !((m_sorted_mask >> static_cast<int>(axis)) & 1))
+    {
+        throw std::invalid_argument(std::string("Lookup axis \"") + 
+            meas_names[static_cast<int>(axis)] + "\" is not monotone in " + m_data_id);
+    }
 }
 
+
+void AxialForceDataset::resampling(arma::fmat *matr, float ts)
+{
+    ArmaExt::resampling<arma::fmat>(matr, ts);
+}
+
+void AxialForceDataset::resampling(arma::fmat *matr, float ts, float t_end)
+{
+    ArmaExt::resampling<arma::fmat>(matr, ts, t_end);
+}
+
+void AxialForceDataset::resampling(arma::fmat *matr, float ts, float t_start, 
+    float t_end)
+{
+    ArmaExt::resampling<arma::fmat>(matr, ts, t_start, t_end);
+}
+
+/**
+ * Derivative of x_vec with respect to t_vec. u_vec is resized only when its 
+ * size differs, so a reused buffer is filled in place.
+*/
+void AxialForceDataset::central_diff_derivative(const arma::fvec &t_vec, 
+    const arma::fvec &x_vec, arma::fvec *u_vec)
+{
+    if (u_vec == &t_vec || u_vec == &x_vec)
+    {
+        arma::fvec u_tmp; central_diff_derivative(t_vec, x_vec, &u_tmp);
+        u_vec->steal_mem(u_tmp); return;
+    }
+
+    u_vec->set_size(x_vec.n_elem);
+    ArmaExt::central_diff<float>(t_vec.memptr(), x_vec.memptr(), 
+        u_vec->memptr(), x_vec.n_elem);
+}
+
+/**
+ * Derivative of x_vec sampled uniformly with period ts.
+*/
+void AxialForceDataset::central_diff_derivative(const arma::fvec &x_vec, 
+    float ts, arma::fvec *u_vec)
+{
+    if (u_vec == &x_vec)
+    {
+        arma::fvec u_tmp; central_diff_derivative(x_vec, ts, &u_tmp);
+        u_vec->steal_mem(u_tmp); return;
+    }
+
+    u_vec->set_size(x_vec.n_elem);
+    ArmaExt::central_diff_uniform<float>(x_vec.memptr(), ts, u_vec->memptr(), 
+        x_vec.n_elem);
+}
+
+arma::fvec AxialForceDataset::channel_view(const arma::fvec &vec)
+{
+    return arma::fvec(const_cast<float *>(vec.memptr()), vec.n_elem, false, true);
+}
+
+
+u_int64_t AxialForceDataset::cache_key(
+    const std::vector<std::vector<std::string>> &files)
+{
+    std::string data_dir = m_share_rel_dir + m_data_id + "/";
+    u_int64_t key = DatasetCache::hash_file(data_dir + m_data_id + ".json");
+
+    for (size_t i = 0; i < files[0].size(); i++)
+    {
+        key = DatasetCache::hash_file(data_dir + files[0][i], key);
+    }
+
+    return key;
+}
+
+
+bool AxialForceDataset::save_cache(std::string cache_name)
+{
+    DatasetCache::Writer writer(cache_name);
+
+    // Header (the file list is stored first to validate the key on reload)
+    writer.put<u_int32_t>(DatasetCache::version);
+    writer.put<u_int8_t>(static_cast<u_int8_t>(m_dup_policy));
+    writer.put<u_int8_t>(static_cast<u_int8_t>(m_vel_diff.get_method()));
+    writer.put<u_int32_t>(m_vel_diff.get_order());
+    writer.put<u_int32_t>(m_vel_diff.get_window());
+    writer.put_strings(m_meas_file);
+    writer.put<u_int64_t>(cache_key(m_meas_file));
+
+    // Channels
+    writer.put<u_int64_t>(m_meas_size); writer.put<u_int32_t>(m_channels_mask);
+    writer.put_matrix(m_channels);
+
+    // Metadata
+    writer.put<u_int64_t>(m_dataset_size);
+    writer.put_string(m_author_name); writer.put_string(m_paper_title);
+    writer.put<int32_t>(m_year); writer.put_string(m_doi);
+
+    writer.put<float>(m_needle_diameter); writer.put_string(m_tip_type);
+    writer.put<float>(m_tip_anlge); writer.put_string(m_tip_sharpness);
+    writer.put_string(m_tip_lubrication);
+
+    writer.put_string(m_tissue_type); writer.put<int32_t>(m_layers_num);
+    writer.put<u_int8_t>(m_multilayer); writer.put<u_int8_t>(m_biological);
+    writer.put_strings(m_tissue_desription);
+
+    writer.put_strings(m_meas_ind_vars); writer.put_strings(m_meas_dep_vars);
+    writer.put_strings(m_meas_const); writer.put_floats(m_meas_const_val);
+    writer.put<int32_t>(m_file_num); writer.put<float>(m_sampling_frequency);
+    writer.put<u_int8_t>(m_const_displ_x); writer.put<u_int8_t>(m_const_vel_x);
+    writer.put<u_int8_t>(m_const_rot_x);
+
+    return writer.commit();
+}
+
+
+bool AxialForceDataset::load_cache(std::string cache_name, bool with_metadata)
+{
+    DatasetCache::Reader reader(cache_name);
+    if (!reader.is_open()) { return false; }
+
+    // Header
+    u_int32_t version; u_int8_t dup_policy; u_int64_t key;
+    u_int8_t diff_method; u_int32_t diff_order, diff_window;
+    std::vector<std::vector<std::string>> files;
+
+    if (!reader.get(version) || version != DatasetCache::version) { return false; }
+    if (!reader.get(dup_policy) || 
+        dup_policy != static_cast<u_int8_t>(m_dup_policy)) { return false; }
+    if (!reader.get(diff_method) || !reader.get(diff_order) || 
+        !reader.get(diff_window) ||
+        diff_method != static_cast<u_int8_t>(m_vel_diff.get_method()) ||
+        diff_order != m_vel_diff.get_order() || 
+        diff_window != m_vel_diff.get_window()) { return false; }
+    if (!reader.get_strings(files) || files.empty()) { return false; }
+    if (!reader.get(key) || key != cache_key(files)) { return false; }
+
+    // Channels
+    bool ok = reader.get(m_meas_size) && reader.get(m_channels_mask) &&
+        reader.get_matrix(m_channels) && 
+        m_channels.n_cols == static_cast<int>(meas_index::total);
+    bind_channels();
+
+    if (!ok || !with_metadata) { return ok; }
+
+    // Metadata
+    int32_t year, layers_num, file_num;
+    u_int8_t multilayer, biological, const_displ_x, const_vel_x, const_rot_x;
+
+    ok = reader.get(m_dataset_size) && reader.get_string(m_author_name) &&
+        reader.get_string(m_paper_title) && reader.get(year) &&
+        reader.get_string(m_doi);
+
+    ok = ok && reader.get(m_needle_diameter) && reader.get_string(m_tip_type) &&
+        reader.get(m_tip_anlge) && reader.get_string(m_tip_sharpness) &&
+        reader.get_string(m_tip_lubrication);
+
+    ok = ok && reader.get_string(m_tissue_type) && reader.get(layers_num) &&
+        reader.get(multilayer) && reader.get(biological) && 
+        reader.get_strings(m_tissue_desription);
+
+    ok = ok && reader.get_strings(m_meas_ind_vars) && 
+        reader.get_strings(m_meas_dep_vars) && reader.get_strings(m_meas_const) &&
+        reader.get_floats(m_meas_const_val) && reader.get(file_num) &&
+        reader.get(m_sampling_frequency) && reader.get(const_displ_x) && 
+        reader.get(const_vel_x) && reader.get(const_rot_x);
+
+    if (!ok) { return false; }
+
+    m_meas_file = files;
+    m_year = year; m_layers_num = layers_num; m_file_num = file_num;
+    m_multilayer = multilayer; m_biological = biological;
+    m_const_displ_x = const_displ_x; m_const_vel_x = const_vel_x;
+    m_const_rot_x = const_rot_x;
+    resolve_meas_ids();
+
+    return true;
+}
+
+
+/**
+ * Copies (or moves, for an rvalue) every member but the lazy-loading mutex 
+ * and the channel views, which are rebound to the new block.
+*/
+template <typename Other>
+void AxialForceDataset::assign_state(Other &&other)
+{
+    // Members of other, moved from when other is an rvalue
+    m_cache_enabled = std::forward<Other>(other).m_cache_enabled;
+    m_lazy_loading = std::forward<Other>(other).m_lazy_loading;
+    m_meas_loaded.store(other.m_meas_loaded.load());
+
+    m_dataset_size = std::forward<Other>(other).m_dataset_size;
+    m_data_id = std::forward<Other>(other).m_data_id;
+    m_author_name = std::forward<Other>(other).m_author_name;
+    m_paper_title = std::forward<Other>(other).m_paper_title;
+    m_year = std::forward<Other>(other).m_year;
+    m_doi = std::forward<Other>(other).m_doi;
+    m_needle_diameter = std::forward<Other>(other).m_needle_diameter;
+    m_tip_type = std::forward<Other>(other).m_tip_type;
+    m_tip_anlge = std::forward<Other>(other).m_tip_anlge;
+    m_tip_sharpness = std::forward<Other>(other).m_tip_sharpness;
+    m_tip_lubrication = std::forward<Other>(other).m_tip_lubrication;
+    m_tissue_type = std::forward<Other>(other).m_tissue_type;
+    m_layers_num = std::forward<Other>(other).m_layers_num;
+    m_multilayer = std::forward<Other>(other).m_multilayer;
+    m_biological = std::forward<Other>(other).m_biological;
+    m_tissue_desription = std::forward<Other>(other).m_tissue_desription;
+    m_tissue_fields = std::forward<Other>(other).m_tissue_fields;
+
+    m_meas_ind_vars = std::forward<Other>(other).m_meas_ind_vars;
+    m_meas_dep_vars = std::forward<Other>(other).m_meas_dep_vars;
+    m_meas_file = std::forward<Other>(other).m_meas_file;
+    m_meas_const = std::forward<Other>(other).m_meas_const;
+    m_meas_const_val = std::forward<Other>(other).m_meas_const_val;
+    m_meas_ind_ids = std::forward<Other>(other).m_meas_ind_ids;
+    m_meas_dep_ids = std::forward<Other>(other).m_meas_dep_ids;
+    m_meas_const_ids = std::forward<Other>(other).m_meas_const_ids;
+    m_uniform_axis = std::forward<Other>(other).m_uniform_axis;
+    m_file_num = std::forward<Other>(other).m_file_num;
+    m_sampling_frequency = std::forward<Other>(other).m_sampling_frequency;
+    m_meas_size = std::forward<Other>(other).m_meas_size;
+    m_x_y = std::forward<Other>(other).m_x_y;
+    m_csv_stats = std::forward<Other>(other).m_csv_stats;
+    m_dup_policy = std::forward<Other>(other).m_dup_policy;
+    m_vel_diff = std::forward<Other>(other).m_vel_diff;
+
+    m_channels = std::forward<Other>(other).m_channels;
+    m_channels_mask = std::forward<Other>(other).m_channels_mask;
+    m_const_displ_x = std::forward<Other>(other).m_const_displ_x;
+    m_const_vel_x = std::forward<Other>(other).m_const_vel_x;
+    m_const_rot_x = std::forward<Other>(other).m_const_rot_x;
+
+    bind_channels();
+}
+
+
 AxialForceDataset::~AxialForceDataset()
 {
-    m_file.close();
-}
\ No newline at end of file
+}
+
+
+#endif
@@ -0,0 +1,344 @@
+#ifndef BATCH_GENERATOR_H
+#define BATCH_GENERATOR_H
+
+#include <vector>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <armadillo>
+#include "axial_force_dataset.hpp"
+
+
+/**
+ * Mini-batch of fixed-size windows. Both tensors are contiguous; inputs is
+ * laid out as [batch][window][channel] and targets as [batch][target].
+**/
+struct Batch
+{
+    arma::fcube inputs; /// Input channels x window length x batch size.
+    arma::fmat targets; /// Target length x batch size.
+    u_int64_t index = 0; /// Position of the batch in the epoch.
+
+    arma::uword size(void) const { return inputs.n_slices; }
+};
+
+
+/**
+ * Cuts the processed channels of one or more datasets into fixed-size windows
+ * and serves them as mini-batches of input channels and target samples (by
+ * default the force at the end of each window). Every epoch visits each
+ * window once, in a deterministic order for a given seed and epoch. The
+ * batches are assembled on a worker thread into a ring of prefetch slots,
+ * and next() swaps the buffers with the consumer, so the steady state does
+ * not allocate.
+**/
+class BatchGenerator
+{
+public:
+
+    /**
+     * @param batch_size Windows per batch.
+     * @param window Window length in samples.
+     * @param stride Samples between the starts of consecutive windows (0
+     * selects the window length, i.e. no overlap).
+    **/
+    BatchGenerator(size_t batch_size=32, size_t window=64, size_t stride=0);
+    ~BatchGenerator();
+
+    BatchGenerator(const BatchGenerator &) = delete;
+    BatchGenerator &operator=(const BatchGenerator &) = delete;
+
+    /**
+     * Adds a dataset. It must provide the input and target channels and
+     * outlive the generator (lazy datasets are loaded here).
+    **/
+    void add(const AxialForceDataset &dataset);
+
+    // Settings (they stop the running epoch and apply from the next one)
+    void set_inputs(const std::vector<AxialForceDataset::meas_index> &inputs);
+    void set_target(AxialForceDataset::meas_index target, size_t length=1);
+    void set_shuffle(bool state, u_int64_t seed=0);
+    void set_drop_last(bool state);
+    void set_prefetch(size_t slots);
+
+    /**
+     * Starts an epoch: the windows are (re)indexed and shuffled with the seed
+     * and the epoch number, and the worker starts filling the ring.
+     * @param epoch Epoch number.
+    **/
+    void start_epoch(u_int64_t epoch=0);
+
+    /**
+     * Takes the next batch of the epoch. Must be called from one thread.
+     * @param batch Receives the batch; its previous buffers are recycled.
+     * @return False at the end of the epoch.
+    **/
+    bool next(Batch *batch);
+
+    // Getters (of the current epoch)
+    u_int64_t get_windows_num(void) const { return m_windows.size(); }
+    u_int64_t get_batches_num(void) const { return m_batches_num; }
+
+private:
+
+    struct Window
+    {
+        u_int32_t dataset;
+        u_int64_t start;
+    };
+
+    size_t m_batch_size;
+    size_t m_window;
+    size_t m_stride;
+    std::vector<AxialForceDataset::meas_index> m_inputs = {
+        AxialForceDataset::meas_index::displ_x, AxialForceDataset::meas_index::vel_x};
+    AxialForceDataset::meas_index m_target = AxialForceDataset::meas_index::force_x;
+    size_t m_target_len = 1;
+    bool m_shuffle = true;
+    u_int64_t m_seed = 0;
+    bool m_drop_last = false;
+
+    std::vector<const AxialForceDataset *> m_datasets;
+    std::vector<Window> m_windows;
+    u_int64_t m_batches_num = 0;
+
+    // Prefetch ring
+    std::vector<Batch> m_slots = std::vector<Batch>(2);
+    u_int64_t m_produced = 0;
+    u_int64_t m_consumed = 0;
+    bool m_stop = false;
+    std::exception_ptr m_error;
+
+    std::mutex m_mutex;
+    std::condition_variable m_ready_cond;
+    std::condition_variable m_space_cond;
+    std::thread m_worker;
+
+private:
+    void check_channels(const AxialForceDataset &dataset) const;
+    void worker_loop(void);
+    void fill(Batch *batch, u_int64_t index) const;
+    void stop(void);
+};
+
+
+BatchGenerator::BatchGenerator(size_t batch_size, size_t window, size_t stride) :
+    m_batch_size(batch_size), m_window(window), m_stride(stride)
+{
+    if (m_batch_size == 0 || m_window == 0)
+    {
+        throw std::invalid_argument("BatchGenerator: empty batches or windows");
+    }
+    if (m_stride == 0) { m_stride = m_window; }
+}
+
+/**************** Methods *****************/
+
+void BatchGenerator::add(const AxialForceDataset &dataset)
+{
+    stop();
+    check_channels(dataset);
+    m_datasets.push_back(&dataset);
+}
+
+void BatchGenerator::set_inputs(const std::vector<AxialForceDataset::meas_index> &inputs)
+{
+    stop();
+    m_inputs = inputs;
+    for (size_t i = 0; i < m_datasets.size(); i++) { check_channels(*m_datasets[i]); }
+}
+
+void BatchGenerator::set_target(AxialForceDataset::meas_index target, size_t length)
+{
+    stop();
+    m_target = target; m_target_len = std::max<size_t>(1, std::min(length, m_window));
+    for (size_t i = 0; i < m_datasets.size(); i++) { check_channels(*m_datasets[i]); }
+}
+
+void BatchGenerator::set_shuffle(bool state, u_int64_t seed)
+{
+    stop();
+    m_shuffle = state; m_seed = seed;
+}
+
+void BatchGenerator::set_drop_last(bool state)
+{
+    stop();
+    m_drop_last = state;
+}
+
+void BatchGenerator::set_prefetch(size_t slots)
+{
+    stop();
+    m_slots.assign(std::max<size_t>(1, slots), Batch());
+}
+
+
+void BatchGenerator::check_channels(const AxialForceDataset &dataset) const
+{
+    for (size_t i = 0; i < m_inputs.size(); i++)
+    {
+        if (!dataset.has_channel(m_inputs[i]))
+        {
+            throw std::invalid_argument("BatchGenerator: missing input channel \"" +
+                std::string(AxialForceDataset::meas_names[static_cast<int>(m_inputs[i])]) +
+                "\" in " + dataset.get_data_id());
+        }
+    }
+
+    if (!dataset.has_channel(m_target))
+    {
+        throw std::invalid_argument("BatchGenerator: missing target channel in " +
+            dataset.get_data_id());
+    }
+}
+
+
+void BatchGenerator::start_epoch(u_int64_t epoch)
+{
+    stop();
+
+    // Window index
+    m_windows.clear();
+    for (size_t d = 0; d < m_datasets.size(); d++)
+    {
+        const u_int64_t n = m_datasets[d]->get_channels().n_rows;
+        for (u_int64_t start = 0; start + m_window <= n; start += m_stride)
+        {
+            m_windows.push_back({static_cast<u_int32_t>(d), start});
+        }
+    }
+
+    // Fisher-Yates with an explicit generator, so the order only depends on
+    // the seed and the epoch
+    if (m_shuffle && m_windows.size() > 1)
+    {
+        std::mt19937_64 rng(m_seed + epoch * 0x9E3779B97F4A7C15ULL);
+        for (size_t i = m_windows.size() - 1; i > 0; i--)
+        {
+            std::swap(m_windows[i], m_windows[rng() % (i + 1)]);
+        }
+    }
+
+    m_batches_num = m_windows.size() / m_batch_size;
+    if (!m_drop_last && m_windows.size() % m_batch_size != 0) { m_batches_num++; }
+
+    m_produced = 0; m_consumed = 0;
+    m_stop = false; m_error = nullptr;
+    m_worker = std::thread(&BatchGenerator::worker_loop, this);
+}
+
+
+bool BatchGenerator::next(Batch *batch)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_consumed >= m_batches_num) { return false; }
+
+    m_ready_cond.wait(lock, [this]() {
+        return m_produced > m_consumed || m_error || m_stop; });
+    if (m_produced <= m_consumed)
+    {
+        if (m_error) { std::rethrow_exception(m_error); }
+        return false;
+    }
+    lock.unlock();
+
+    // The worker does not touch a full slot until it is consumed
+    Batch &slot = m_slots[m_consumed % m_slots.size()];
+    batch->inputs.swap(slot.inputs); batch->targets.swap(slot.targets);
+    batch->index = slot.index;
+
+    lock.lock();
+    m_consumed++;
+    lock.unlock();
+
+    m_space_cond.notify_one();
+    return true;
+}
+
+
+void BatchGenerator::worker_loop(void)
+{
+    for (u_int64_t b = 0; b < m_batches_num; b++)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_space_cond.wait(lock, [this, b]() {
+                return m_stop || b - m_consumed < m_slots.size(); });
+            if (m_stop) { return; }
+        }
+
+        try { fill(&m_slots[b % m_slots.size()], b); }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_error = std::current_exception();
+            m_ready_cond.notify_one();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_produced = b + 1;
+        }
+        m_ready_cond.notify_one();
+    }
+}
+
+
+/**
+ * Gathers the windows of batch index. The buffers are reused when the batch
+ * has the same size as the one they held.
+**/
+void BatchGenerator::fill(Batch *batch, u_int64_t index) const
+{
+    const u_int64_t first = index * m_batch_size;
+    const u_int64_t size = std::min<u_int64_t>(m_batch_size, m_windows.size() - first);
+    const arma::uword channels = m_inputs.size();
+
+    batch->inputs.set_size(channels, m_window, size);
+    batch->targets.set_size(m_target_len, size);
+    batch->index = index;
+
+    for (u_int64_t s = 0; s < size; s++)
+    {
+        const Window &w = m_windows[first + s];
+        const arma::fmat &block = m_datasets[w.dataset]->get_channels();
+        float *dst = batch->inputs.slice_memptr(s);
+
+        for (arma::uword c = 0; c < channels; c++)
+        {
+            const float *src = block.colptr(static_cast<int>(m_inputs[c])) + w.start;
+            for (size_t t = 0; t < m_window; t++) { dst[t * channels + c] = src[t]; }
+        }
+
+        const float *target = block.colptr(static_cast<int>(m_target)) +
+            w.start + m_window - m_target_len;
+        std::copy(target, target + m_target_len, batch->targets.colptr(s));
+    }
+}
+
+
+void BatchGenerator::stop(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_space_cond.notify_all(); m_ready_cond.notify_all();
+    if (m_worker.joinable()) { m_worker.join(); }
+}
+
+
+BatchGenerator::~BatchGenerator()
+{
+    stop();
+}
+
+
+#endif
@@ -0,0 +1,376 @@
+#ifndef DATASET_CATALOG_H
+#define DATASET_CATALOG_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "axial_force_dataset.hpp"
+#include "include/thread_pool.hpp"
+
+
+/**
+ * Load-time statistics of a catalog entry.
+**/
+struct DatasetLoadStats
+{
+    double queue_ms = 0; /// Time spent waiting for a worker.
+    double load_ms = 0; /// Time spent in data_parsing.
+    u_int64_t samples = 0; /// Number of resampled samples per channel (0 if lazy).
+    u_int64_t bytes = 0; /// Memory held by the processed channels (0 if lazy).
+    bool loaded = false; /// True when the load finished without errors.
+};
+
+
+/**
+ * The class discovers the datasets of the share/ directory and loads them
+ * concurrently on a bounded thread pool.
+**/
+class DatasetCatalog
+{
+public:
+
+    /**
+     * @param threads_num Number of loader threads (0 selects the hardware
+     * concurrency).
+    **/
+    DatasetCatalog(unsigned int threads_num=0);
+    ~DatasetCatalog();
+
+    /**
+     * Lists the dataset folders of share/ that contain a <data_id>.json file.
+     * @return Sorted dataset ids.
+    **/
+    std::vector<std::string> discover(void);
+
+    /**
+     * Lists the dataset ids of the aggregate share/axial_force_data.json file
+     * that can be loaded, i.e. that have a share/<data_id>/<data_id>.json file
+     * (the measurement files are only referenced from the dataset folders).
+     * @return Dataset ids in file order.
+    **/
+    std::vector<std::string> discover_from_aggregate(void);
+
+    /**
+     * Queues the given datasets for loading. Ids that are already part of the
+     * catalog are ignored.
+     * @param data_ids The datasets to be loaded.
+    **/
+    void load(const std::vector<std::string> &data_ids);
+    void load_all(void) { load(discover()); }
+
+    /**
+     * Blocks until the dataset is loaded. Parsing errors are rethrown.
+     * @param data_id The dataset id.
+     * @return The loaded dataset.
+    **/
+    AxialForceDataset &wait(const std::string &data_id);
+
+    /**
+     * Blocks until the next dataset (in completion order) finishes loading.
+     * @return The dataset id, or an empty string when every queued dataset
+     * has already been returned.
+    **/
+    std::string wait_next(void);
+
+    void wait_all(void);
+
+    // Getters
+    std::vector<std::string> get_data_ids(void);
+    DatasetLoadStats get_stats(const std::string &data_id);
+    size_t get_size(void);
+
+    void set_cache_enabled(bool state) { m_cache_enabled = state; }
+    void set_lazy_loading(bool state) { m_lazy_loading = state; }
+
+private:
+
+    const std::string m_lib_rel_path = "./include/axial_force_dataset/";
+    const std::string m_share_rel_dir = m_lib_rel_path + "share/";
+    const std::string m_aggregate_name = "axial_force_data.json";
+
+    typedef std::chrono::steady_clock clock;
+
+    class KeySax;
+
+    struct Entry
+    {
+        std::unique_ptr<AxialForceDataset> dataset;
+        std::shared_future<void> done;
+        DatasetLoadStats stats;
+    };
+
+    std::map<std::string, std::shared_ptr<Entry>> m_entries;
+    std::vector<std::string> m_order;
+    std::deque<std::string> m_completed;
+    size_t m_returned = 0;
+    bool m_cache_enabled = false;
+    bool m_lazy_loading = false;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+
+    ThreadPool m_pool;
+
+private:
+    bool has_dataset(const std::string &data_id);
+    void load_entry(std::string data_id, std::shared_ptr<Entry> entry,
+        clock::time_point queued);
+    std::shared_ptr<Entry> find_entry(const std::string &data_id);
+};
+
+
+/**
+ * SAX handler that lists the top-level keys of a JSON object without 
+ * building the document.
+**/
+class DatasetCatalog::KeySax : public nlohmann::json_sax<nlohmann::json>
+{
+public:
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+    bool number_integer(number_integer_t) override { return true; }
+    bool number_unsigned(number_unsigned_t) override { return true; }
+    bool number_float(number_float_t, const string_t &) override { return true; }
+    bool string(string_t &) override { return true; }
+    bool binary(binary_t &) override { return true; }
+
+    bool start_object(std::size_t) override { m_depth++; return true; }
+    bool end_object() override { m_depth--; return true; }
+    bool start_array(std::size_t) override { m_depth++; return true; }
+    bool end_array() override { m_depth--; return true; }
+
+    bool key(string_t &val) override
+    {
+        if (m_depth == 1) { m_keys.push_back(val); }
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string &, 
+        const nlohmann::detail::exception &) override { return false; }
+
+    std::vector<std::string> &get_keys(void) { return m_keys; }
+
+private:
+    int m_depth = 0;
+    std::vector<std::string> m_keys;
+};
+
+
+DatasetCatalog::DatasetCatalog(unsigned int threads_num) : m_pool(threads_num)
+{
+}
+
+/**************** Methods *****************/
+
+std::vector<std::string> DatasetCatalog::discover(void)
+{
+    std::vector<std::string> data_ids;
+
+    DIR *dir = opendir(m_share_rel_dir.c_str());
+    if (dir == nullptr) { return data_ids; }
+
+    struct dirent *item;
+    while ((item = readdir(dir)) != nullptr)
+    {
+        std::string name = item->d_name;
+        if (name == "." || name == "..") { continue; }
+
+        if (has_dataset(name)) { data_ids.push_back(name); }
+    }
+    closedir(dir);
+
+    std::sort(data_ids.begin(), data_ids.end());
+    return data_ids;
+}
+
+
+std::vector<std::string> DatasetCatalog::discover_from_aggregate(void)
+{
+    std::vector<std::string> data_ids;
+
+    std::string file_name = m_share_rel_dir + m_aggregate_name;
+    std::ifstream file(file_name);
+    if (!file.is_open()) { return data_ids; }
+
+    // Only the top-level keys are needed, so the file is not stored
+    KeySax sax;
+    if (!nlohmann::json::sax_parse(file, &sax))
+    {
+        throw std::runtime_error(file_name + ": parse error");
+    }
+
+    std::vector<std::string> &keys = sax.get_keys();
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (has_dataset(keys[i])) { data_ids.push_back(keys[i]); }
+    }
+
+    return data_ids;
+}
+
+
+bool DatasetCatalog::has_dataset(const std::string &data_id)
+{
+    std::string json_name = m_share_rel_dir + data_id + "/" + data_id + ".json";
+    struct stat st;
+
+    return stat(json_name.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+
+void DatasetCatalog::load(const std::vector<std::string> &data_ids)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (size_t i = 0; i < data_ids.size(); i++)
+    {
+        const std::string &data_id = data_ids[i];
+        if (m_entries.count(data_id) != 0) { continue; }
+
+        std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+        entry->dataset.reset(new AxialForceDataset());
+        entry->dataset->set_cache_enabled(m_cache_enabled);
+        entry->dataset->set_lazy_loading(m_lazy_loading);
+
+        clock::time_point queued = clock::now();
+        entry->done = m_pool.submit([this, data_id, entry, queued]() {
+            load_entry(data_id, entry, queued); }).share();
+
+        m_entries[data_id] = entry;
+        m_order.push_back(data_id);
+    }
+}
+
+
+void DatasetCatalog::load_entry(std::string data_id,
+    std::shared_ptr<Entry> entry, clock::time_point queued)
+{
+    clock::time_point start = clock::now();
+
+    try
+    {
+        entry->dataset->data_parsing(data_id);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        entry->stats.queue_ms =
+            std::chrono::duration<double, std::milli>(start - queued).count();
+        m_completed.push_back(data_id);
+        m_cond.notify_all();
+        throw;
+    }
+
+    clock::time_point stop = clock::now();
+    const AxialForceDataset &dataset = *entry->dataset;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    entry->stats.queue_ms =
+        std::chrono::duration<double, std::milli>(start - queued).count();
+    entry->stats.load_ms =
+        std::chrono::duration<double, std::milli>(stop - start).count();
+    entry->stats.loaded = true;
+
+    // Lazy datasets report their size once the channels are materialised
+    if (dataset.is_meas_loaded())
+    {
+        entry->stats.samples = dataset.get_time().n_elem;
+        entry->stats.bytes = sizeof(float) * (dataset.get_time().n_elem +
+            dataset.get_displ_x().n_elem + dataset.get_vel_x().n_elem +
+            dataset.get_rot_x().n_elem + dataset.get_force_x().n_elem);
+    }
+
+    m_completed.push_back(data_id);
+    m_cond.notify_all();
+}
+
+
+AxialForceDataset &DatasetCatalog::wait(const std::string &data_id)
+{
+    std::shared_ptr<Entry> entry = find_entry(data_id);
+    entry->done.get();
+    return *entry->dataset;
+}
+
+
+std::string DatasetCatalog::wait_next(void)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_returned == m_order.size()) { return ""; }
+
+    m_cond.wait(lock, [this]() { return !m_completed.empty(); });
+
+    std::string data_id = m_completed.front();
+    m_completed.pop_front();
+    m_returned++;
+    return data_id;
+}
+
+
+void DatasetCatalog::wait_all(void)
+{
+    std::vector<std::shared_future<void>> futures;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_order.size(); i++)
+        {
+            futures.push_back(m_entries[m_order[i]]->done);
+        }
+    }
+
+    for (size_t i = 0; i < futures.size(); i++) { futures[i].wait(); }
+}
+
+
+std::vector<std::string> DatasetCatalog::get_data_ids(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_order;
+}
+
+
+DatasetLoadStats DatasetCatalog::get_stats(const std::string &data_id)
+{
+    std::shared_ptr<Entry> entry = find_entry(data_id);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return entry->stats;
+}
+
+
+size_t DatasetCatalog::get_size(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_order.size();
+}
+
+
+std::shared_ptr<DatasetCatalog::Entry> DatasetCatalog::find_entry(
+    const std::string &data_id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(data_id);
+
+    if (it == m_entries.end())
+    {
+        throw std::out_of_range("Dataset \"" + data_id + "\" is not loaded");
+    }
+
+    return it->second;
+}
+
+
+DatasetCatalog::~DatasetCatalog()
+{
+}
+
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef CHANNEL_LOOKUP_H
+#define CHANNEL_LOOKUP_H
+
+#include <algorithm>
+#include <armadillo>
+
+
+/**
+ * Point queries on sampled channels. A query is located on a non-decreasing
+ * axis (in O(1) when the axis is uniformly sampled, by binary search
+ * otherwise) and the channel is interpolated between the bracketing samples.
+**/
+class ChannelLookup
+{
+    public:
+        ChannelLookup() {};
+
+        enum class method
+        {
+            linear, cubic
+        };
+
+        template <typename eT>
+        static arma::uword locate_uniform(const eT *axis, arma::uword n,
+            eT inv_step, eT q);
+
+        template <typename eT>
+        static arma::uword locate_sorted(const eT *axis, arma::uword n, eT q,
+            arma::uword hint=0);
+
+        template <typename eT>
+        static eT interpolate(const eT *axis, const eT *y, arma::uword n,
+            arma::uword i, eT q, method type=method::linear);
+};
+
+
+/**
+ * Index i of the segment [axis[i], axis[i+1]) holding q on a uniform axis,
+ * computed from the sampling step and corrected by one sample for rounding.
+ * @param axis Uniformly sampled axis (n samples)
+ * @param n Number of samples
+ * @param inv_step Inverse of the sampling step
+ * @param q Query point
+ * @return Segment index, clamped to [0, n-2]
+*/
+template <typename eT>
+arma::uword ChannelLookup::locate_uniform(const eT *axis, arma::uword n,
+    eT inv_step, eT q)
+{
+    if (n < 2) { return 0; }
+
+    const eT pos = (q - axis[0]) * inv_step;
+    arma::uword i = (pos >= eT(0)) ?
+        ((pos < eT(n - 2)) ? static_cast<arma::uword>(pos) : n - 2) : 0;
+
+    if (i > 0 && q < axis[i]) { i--; }
+    else if (i + 2 < n && q >= axis[i + 1]) { i++; }
+
+    return i;
+}
+
+/**
+ * Index i of the segment [axis[i], axis[i+1]) holding q on a non-decreasing
+ * axis. When q is not below axis[hint] the search starts from hint, which
+ * makes ascending batches of queries cheaper.
+ * @param axis Non-decreasing axis (n samples)
+ * @param n Number of samples
+ * @param q Query point
+ * @param hint Segment of a previous query
+ * @return Segment index, clamped to [0, n-2]
+*/
+template <typename eT>
+arma::uword ChannelLookup::locate_sorted(const eT *axis, arma::uword n, eT q,
+    arma::uword hint)
+{
+    if (n < 2) { return 0; }
+
+    const eT *first = (hint < n && axis[hint] <= q) ? axis + hint : axis;
+    const arma::uword upper = std::upper_bound(first, axis + n, q) - axis;
+
+    return std::min<arma::uword>((upper > 0) ? upper - 1 : 0, n - 2);
+}
+
+/**
+ * Value of y at q, from the segment i located on the axis. Queries outside
+ * the axis range return the end values. The cubic option is a cubic Hermite
+ * spline with central difference slopes (Catmull-Rom on uniform axes).
+ * @param axis Non-decreasing axis (n samples)
+ * @param y Channel (n samples)
+ * @param n Number of samples
+ * @param i Segment index of q
+ * @param q Query point
+ * @param type Interpolation method
+ * @return Interpolated value
+*/
+template <typename eT>
+eT ChannelLookup::interpolate(const eT *axis, const eT *y, arma::uword n,
+    arma::uword i, eT q, method type)
+{
+    if (n < 2 || q <= axis[0]) { return y[0]; }
+    if (q >= axis[n - 1]) { return y[n - 1]; }
+
+    const eT h = axis[i + 1] - axis[i];
+    if (h <= eT(0)) { return y[i + 1]; }
+
+    const eT t = (q - axis[i]) / h;
+
+    if (type == method::linear) { return y[i] + t * (y[i + 1] - y[i]); }
+
+    // Slopes at both ends of the segment (one-sided at the channel ends)
+    const arma::uword i0 = (i > 0) ? i - 1 : i;
+    const arma::uword i3 = (i + 2 < n) ? i + 2 : i + 1;
+    const eT d0 = axis[i + 1] - axis[i0]; const eT d1 = axis[i3] - axis[i];
+    const eT m0 = (d0 > eT(0)) ? (y[i + 1] - y[i0]) / d0 : eT(0);
+    const eT m1 = (d1 > eT(0)) ? (y[i3] - y[i]) / d1 : eT(0);
+
+    const eT t2 = t * t; const eT t3 = t2 * t;
+    const eT h00 = 2 * t3 - 3 * t2 + 1; const eT h10 = t3 - 2 * t2 + t;
+    const eT h01 = -2 * t3 + 3 * t2; const eT h11 = t3 - t2;
+
+    return h00 * y[i] + h10 * h * m0 + h01 * y[i + 1] + h11 * h * m1;
+}
+
+
+#endif
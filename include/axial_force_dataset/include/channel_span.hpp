@@ -0,0 +1,43 @@
+#ifndef CHANNEL_SPAN_H
+#define CHANNEL_SPAN_H
+
+#include <cstddef>
+#include <armadillo>
+
+
+/**
+ * Non-owning read-only view over a strided sequence of elements of type eT.
+ * The span stays valid as long as the storage it was created from is neither
+ * resized nor destroyed.
+**/
+template <typename eT>
+class ChannelSpan
+{
+    public:
+        ChannelSpan() {};
+
+        ChannelSpan(const eT *data, size_t size, size_t stride=1) :
+            m_data(data), m_size(size), m_stride(stride) {};
+
+        ChannelSpan(const arma::Col<eT> &vec) :
+            m_data(vec.memptr()), m_size(vec.n_elem), m_stride(1) {};
+
+        const eT &operator[](size_t i) const { return m_data[i * m_stride]; }
+
+        const eT *data(void) const { return m_data; }
+        size_t size(void) const { return m_size; }
+        size_t stride(void) const { return m_stride; }
+        bool empty(void) const { return m_size == 0; }
+        bool is_contiguous(void) const { return m_stride == 1; }
+
+        const eT &front(void) const { return m_data[0]; }
+        const eT &back(void) const { return m_data[(m_size - 1) * m_stride]; }
+
+    private:
+        const eT *m_data = nullptr;
+        size_t m_size = 0;
+        size_t m_stride = 1;
+};
+
+
+#endif
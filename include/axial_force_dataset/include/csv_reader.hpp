@@ -0,0 +1,286 @@
+#ifndef CSV_READER_H
+#define CSV_READER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <armadillo>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+/**
+ * Statistics of a CSV load.
+**/
+struct CsvStats
+{
+    u_int64_t bytes = 0; /// Size of the parsed file.
+    u_int64_t rows = 0; /// Rows stored in the matrix.
+    u_int64_t cols = 0; /// Columns of the matrix.
+    u_int64_t malformed_lines = 0; /// Non-empty lines that were skipped.
+    u_int64_t fallback_fields = 0; /// Fields parsed by the fallback path.
+    double seconds = 0; /// Wall time of the load.
+
+    double bytes_per_second(void) const {
+        return (seconds > 0) ? (bytes / seconds) : 0;
+    }
+};
+
+
+/**
+ * Reader of numeric comma separated files. The file is memory mapped and
+ * every field is parsed by a locale-free fast path directly into a
+ * preallocated column-major Armadillo matrix.
+**/
+class CsvReader
+{
+    public:
+        CsvReader() {};
+
+        template <typename T>
+        static bool load(const std::string &filename, T *matr,
+            CsvStats *stats=nullptr);
+
+    private:
+        static bool parse_field(const char *&p, const char *end, double &val);
+        static bool parse_fallback(const char *&p, const char *end, double &val);
+        static u_int64_t count_fields(const char *p, const char *end);
+        static const char *skip_blank(const char *p, const char *end);
+        static const char *line_end(const char *p, const char *end);
+};
+
+
+/**
+ * Loads a CSV file into an Armadillo matrix of type T. The number of columns
+ * is defined by the first non-empty line; lines with a different number of
+ * numeric fields are skipped and counted as malformed.
+ * @param filename The file to be loaded.
+ * @param matr Armadillo matrix of type T.
+ * @param stats Optional load statistics.
+ * @return False if the file cannot be mapped.
+*/
+template <typename T>
+bool CsvReader::load(const std::string &filename, T *matr, CsvStats *stats)
+{
+    typedef typename T::elem_type eT;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) { return false; }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return false; }
+
+    size_t size = st.st_size;
+    if (size == 0) { close(fd); matr->reset(); return true; }
+
+    void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) { return false; }
+
+    const char *begin = (const char *) addr;
+    const char *end = begin + size;
+
+    // Count non-empty lines and the columns of the first one
+    u_int64_t rows = 0; u_int64_t cols = 0;
+    for (const char *p = begin; p < end; )
+    {
+        const char *eol = line_end(p, end);
+        const char *q = skip_blank(p, eol);
+
+        if (q < eol)
+        {
+            if (rows == 0) { cols = count_fields(q, eol); }
+            rows++;
+        }
+        p = eol + 1;
+    }
+
+    matr->set_size(rows, cols);
+    eT *mem = matr->memptr();
+
+    u_int64_t row = 0; u_int64_t malformed = 0; u_int64_t fallback = 0;
+    for (const char *p = begin; p < end && row < rows; )
+    {
+        const char *eol = line_end(p, end);
+        const char *q = skip_blank(p, eol);
+        if (q == eol) { p = eol + 1; continue; }
+
+        u_int64_t col = 0;
+        while (col < cols)
+        {
+            double val;
+            if (!parse_field(q, eol, val))
+            {
+                if (!parse_fallback(q, eol, val)) { break; }
+                fallback++;
+            }
+            mem[col * rows + row] = (eT) val;
+            col++;
+
+            q = skip_blank(q, eol);
+            if (q < eol && *q == ',') { q = skip_blank(q + 1, eol); }
+            else { break; }
+        }
+
+        if (col == cols && skip_blank(q, eol) == eol) { row++; }
+        else { malformed++; }
+
+        p = eol + 1;
+    }
+
+    munmap(addr, size);
+
+    // Drop the rows reserved for skipped lines
+    if (row < rows) { matr->resize(row, cols); }
+
+    if (stats != nullptr)
+    {
+        stats->bytes = size; stats->rows = row; stats->cols = cols;
+        stats->malformed_lines = malformed; stats->fallback_fields = fallback;
+        stats->seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+    return true;
+}
+
+
+/**
+ * Parses a decimal number ([+-]digits[.digits][(e|E)[+-]digits]) without
+ * locale or stream overhead. Up to 19 significant digits are kept and the
+ * value is scaled by exact powers of ten.
+ * @param p Parsing position, advanced past the number on success.
+ * @param end End of the line.
+ * @param val Parsed value.
+ * @return False if the field is not a plain decimal number.
+*/
+bool CsvReader::parse_field(const char *&p, const char *end, double &val)
+{
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+        1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+        1e20, 1e21, 1e22};
+
+    const char *q = p;
+    bool negative = false;
+    if (q < end && (*q == '-' || *q == '+')) { negative = (*q == '-'); q++; }
+
+    u_int64_t mantissa = 0; int digits = 0; int exponent = 0;
+    bool any_digit = false;
+
+    // Integer part
+    for (; q < end && (unsigned) (*q - '0') < 10; q++)
+    {
+        any_digit = true;
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*q - '0');
+            if (mantissa != 0) { digits++; }
+        }
+        else { exponent++; }
+    }
+
+    // Fractional part
+    if (q < end && *q == '.')
+    {
+        q++;
+        for (; q < end && (unsigned) (*q - '0') < 10; q++)
+        {
+            any_digit = true;
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*q - '0');
+                if (mantissa != 0) { digits++; }
+                exponent--;
+            }
+        }
+    }
+
+    if (!any_digit) { return false; }
+
+    // Exponent
+    if (q < end && (*q == 'e' || *q == 'E'))
+    {
+        q++;
+        bool exp_negative = false;
+        if (q < end && (*q == '-' || *q == '+')) { exp_negative = (*q == '-'); q++; }
+        if (q == end || (unsigned) (*q - '0') >= 10) { return false; }
+
+        int exp_val = 0;
+        for (; q < end && (unsigned) (*q - '0') < 10; q++)
+        {
+            if (exp_val < 10000) { exp_val = exp_val * 10 + (*q - '0'); }
+        }
+        exponent += (exp_negative) ? -exp_val : exp_val;
+    }
+
+    if (mantissa == 0) { exponent = 0; }
+    if (exponent < -44 || exponent > 44) { return false; }
+
+    double result = (double) mantissa;
+    if (exponent < -22) { result /= pow10[22]; exponent += 22; }
+    if (exponent > 22) { result *= pow10[22]; exponent -= 22; }
+    result = (exponent < 0) ? (result / pow10[-exponent]) : (result * pow10[exponent]);
+
+    val = (negative) ? -result : result;
+    p = q;
+    return true;
+}
+
+
+/**
+ * Parses a field with strtod (handles nan, inf, hexadecimal and very large
+ * exponents).
+*/
+bool CsvReader::parse_fallback(const char *&p, const char *end, double &val)
+{
+    const char *q = p;
+    while (q < end && *q != ',' && *q != ' ' && *q != '\t' && *q != '\r') { q++; }
+    if (q == p) { return false; }
+
+    std::string field(p, q);
+    char *field_end;
+    val = std::strtod(field.c_str(), &field_end);
+    if (field_end != field.c_str() + field.size()) { return false; }
+
+    p = q;
+    return true;
+}
+
+
+/**
+ * Counts the fields of a line. A trailing comma (followed only by blanks) 
+ * does not open an empty field.
+*/
+u_int64_t CsvReader::count_fields(const char *p, const char *end)
+{
+    u_int64_t fields = 1;
+    for (; p < end; p++)
+    {
+        if (*p == ',' && skip_blank(p + 1, end) < end) { fields++; }
+    }
+    return fields;
+}
+
+
+const char *CsvReader::skip_blank(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) { p++; }
+    return p;
+}
+
+
+const char *CsvReader::line_end(const char *p, const char *end)
+{
+    const char *eol = (const char *) std::memchr(p, '\n', end - p);
+    return (eol == nullptr) ? end : eol;
+}
+
+
+#endif
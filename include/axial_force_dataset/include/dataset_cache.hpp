@@ -0,0 +1,298 @@
+#ifndef DATASET_CACHE_H
+#define DATASET_CACHE_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+#include <armadillo>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+/**
+ * Versioned binary storage of processed datasets. Files are written
+ * sequentially and read back through a read-only memory mapping, from which
+ * every block is copied once into the memory of the dataset.
+**/
+class DatasetCache
+{
+    public:
+        DatasetCache() {};
+
+        static const u_int32_t version = 8;
+
+        static u_int64_t hash_file(const std::string &filename,
+            u_int64_t seed=fnv_offset);
+
+        class Writer;
+        class Reader;
+
+    private:
+        static const u_int64_t fnv_offset = 14695981039346656037ULL;
+        static const u_int64_t fnv_prime = 1099511628211ULL;
+};
+
+
+/**
+ * Sequential writer of a cache file. The data is written to a temporary file
+ * that replaces the target on commit, so readers never see partial files.
+**/
+class DatasetCache::Writer
+{
+    public:
+        Writer(const std::string &filename);
+        ~Writer();
+
+        template <typename T>
+        void put(T val) { m_file.write((const char *) &val, sizeof(T)); }
+
+        void put_string(const std::string &str);
+        void put_strings(const std::vector<std::vector<std::string>> &str);
+        void put_floats(const std::vector<std::vector<float>> &val);
+        void put_matrix(const arma::fmat &mat);
+
+        bool commit(void);
+
+    private:
+        std::string m_filename;
+        std::string m_tmp_filename;
+        std::ofstream m_file;
+        bool m_committed = false;
+};
+
+
+/**
+ * Bounds-checked reader over a memory mapped cache file. The getters copy
+ * out of the mapping (which is released with the reader) and return false
+ * once the end of the mapping has been reached.
+**/
+class DatasetCache::Reader
+{
+    public:
+        Reader(const std::string &filename);
+        ~Reader();
+
+        bool is_open(void) { return m_data != nullptr; }
+
+        template <typename T>
+        bool get(T &val);
+
+        bool get_string(std::string &str);
+        bool get_strings(std::vector<std::vector<std::string>> &str);
+        bool get_floats(std::vector<std::vector<float>> &val);
+        bool get_matrix(arma::fmat &mat);
+
+    private:
+        const char *m_data = nullptr;
+        size_t m_size = 0;
+        size_t m_offset = 0;
+
+        bool get_raw(void *dst, size_t bytes);
+};
+
+
+/**
+ * Computes the FNV-1a hash of the contents of a file.
+ * @param filename The file to be hashed.
+ * @param seed Initial hash value (used to chain several files).
+ * @return The 64-bit hash. The seed is returned when the file cannot be read.
+**/
+u_int64_t DatasetCache::hash_file(const std::string &filename, u_int64_t seed)
+{
+    u_int64_t hash = seed;
+    std::ifstream file(filename, std::ios::binary);
+    char buffer[1 << 16];
+
+    while (file)
+    {
+        file.read(buffer, sizeof(buffer));
+        std::streamsize n = file.gcount();
+
+        for (std::streamsize i = 0; i < n; i++)
+        {
+            hash ^= (unsigned char) buffer[i];
+            hash *= fnv_prime;
+        }
+    }
+
+    return hash;
+}
+
+
+/**************** Writer *****************/
+
+DatasetCache::Writer::Writer(const std::string &filename) :
+    m_filename(filename)
+{
+    // The pid keeps processes apart, the counter keeps the writers of one process apart
+    static std::atomic<unsigned int> writer_count(0);
+    m_tmp_filename = filename + ".tmp" + std::to_string(getpid())
+        + "." + std::to_string(writer_count++);
+    m_file.open(m_tmp_filename, std::ios::binary | std::ios::trunc);
+}
+
+void DatasetCache::Writer::put_string(const std::string &str)
+{
+    put<u_int64_t>(str.size());
+    m_file.write(str.data(), str.size());
+}
+
+void DatasetCache::Writer::put_strings(
+    const std::vector<std::vector<std::string>> &str)
+{
+    put<u_int64_t>(str.size());
+    for (size_t i = 0; i < str.size(); i++)
+    {
+        put<u_int64_t>(str[i].size());
+        for (size_t j = 0; j < str[i].size(); j++) { put_string(str[i][j]); }
+    }
+}
+
+void DatasetCache::Writer::put_floats(const std::vector<std::vector<float>> &val)
+{
+    put<u_int64_t>(val.size());
+    for (size_t i = 0; i < val.size(); i++)
+    {
+        put<u_int64_t>(val[i].size());
+        m_file.write((const char *) val[i].data(), val[i].size() * sizeof(float));
+    }
+}
+
+void DatasetCache::Writer::put_matrix(const arma::fmat &mat)
+{
+    put<u_int64_t>(mat.n_rows); put<u_int64_t>(mat.n_cols);
+    m_file.write((const char *) mat.memptr(), mat.n_elem * sizeof(float));
+}
+
+bool DatasetCache::Writer::commit(void)
+{
+    m_file.close();
+    if (m_file.fail()) { return false; }
+
+    m_committed = (std::rename(m_tmp_filename.c_str(), m_filename.c_str()) == 0);
+    return m_committed;
+}
+
+DatasetCache::Writer::~Writer()
+{
+    if (m_file.is_open()) { m_file.close(); }
+    if (!m_committed) { std::remove(m_tmp_filename.c_str()); }
+}
+
+
+/**************** Reader *****************/
+
+DatasetCache::Reader::Reader(const std::string &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) { return; }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (addr != MAP_FAILED)
+        {
+            m_data = (const char *) addr;
+            m_size = st.st_size;
+        }
+    }
+
+    close(fd);
+}
+
+template <typename T>
+bool DatasetCache::Reader::get(T &val)
+{
+    return get_raw(&val, sizeof(T));
+}
+
+bool DatasetCache::Reader::get_raw(void *dst, size_t bytes)
+{
+    if (m_data == nullptr || bytes > m_size - m_offset) { return false; }
+    if (bytes == 0) { return true; }
+
+    std::memcpy(dst, m_data + m_offset, bytes);
+    m_offset += bytes;
+    return true;
+}
+
+bool DatasetCache::Reader::get_string(std::string &str)
+{
+    u_int64_t n;
+    if (!get(n) || n > m_size - m_offset) { return false; }
+
+    str.assign(m_data + m_offset, n);
+    m_offset += n;
+    return true;
+}
+
+bool DatasetCache::Reader::get_strings(
+    std::vector<std::vector<std::string>> &str)
+{
+    u_int64_t rows;
+    if (!get(rows) || rows > m_size - m_offset) { return false; }
+    str.assign(rows, std::vector<std::string>());
+
+    for (u_int64_t i = 0; i < rows; i++)
+    {
+        u_int64_t cols;
+        if (!get(cols) || cols > m_size - m_offset) { return false; }
+        str[i].resize(cols);
+
+        for (u_int64_t j = 0; j < cols; j++)
+        {
+            if (!get_string(str[i][j])) { return false; }
+        }
+    }
+
+    return true;
+}
+
+bool DatasetCache::Reader::get_floats(std::vector<std::vector<float>> &val)
+{
+    u_int64_t rows;
+    if (!get(rows) || rows > m_size - m_offset) { return false; }
+    val.assign(rows, std::vector<float>());
+
+    for (u_int64_t i = 0; i < rows; i++)
+    {
+        u_int64_t cols;
+        if (!get(cols) || cols > (m_size - m_offset) / sizeof(float))
+        {
+            return false;
+        }
+        val[i].resize(cols);
+        if (!get_raw(val[i].data(), cols * sizeof(float))) { return false; }
+    }
+
+    return true;
+}
+
+bool DatasetCache::Reader::get_matrix(arma::fmat &mat)
+{
+    u_int64_t rows, cols;
+    if (!get(rows) || !get(cols)) { return false; }
+
+    const u_int64_t avail = (m_size - m_offset) / sizeof(float);
+    if (cols != 0 && rows > avail / cols) { return false; }
+
+    mat.set_size(rows, cols);
+    return get_raw(mat.memptr(), rows * cols * sizeof(float));
+}
+
+DatasetCache::Reader::~Reader()
+{
+    if (m_data != nullptr) { munmap((void *) m_data, m_size); }
+}
+
+
+#endif
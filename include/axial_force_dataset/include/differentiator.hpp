@@ -0,0 +1,245 @@
+#ifndef DIFFERENTIATOR_H
+#define DIFFERENTIATOR_H
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <armadillo>
+#include "armaext.hpp"
+
+
+/**
+ * First derivative of uniformly sampled signals. Besides the plain central
+ * difference, Savitzky-Golay differentiators fit a polynomial of the given
+ * order over a sliding window and differentiate the fit, which suppresses the
+ * noise amplified by the central difference. The convolution coefficients are
+ * computed once, on construction.
+**/
+class Differentiator
+{
+    public:
+        enum class method
+        {
+            central_diff, savitzky_golay
+        };
+
+        /**
+         * @param type Differentiation method
+         * @param order Polynomial order (Savitzky-Golay only)
+         * @param window Odd window length, greater than the order
+         * (Savitzky-Golay only)
+        **/
+        Differentiator(method type=method::central_diff, unsigned int order=2,
+            unsigned int window=7);
+
+        method get_method(void) const { return m_method; }
+        unsigned int get_order(void) const { return m_order; }
+        unsigned int get_window(void) const { return m_window; }
+
+        /**
+         * Coefficients of the window centre, in window order (applied to
+         * x[i-m] ... x[i+m] and divided by the sampling interval).
+        **/
+        const std::vector<float> &get_coefficients(void) const { return m_centre; }
+
+        /**
+         * Differentiates x_vec sampled with period ts into u_vec, which is
+         * resized only when its size differs. Signals shorter than the window
+         * fall back to the central difference.
+        **/
+        void apply(const arma::fvec &x_vec, float ts, arma::fvec *u_vec) const;
+
+        /**
+         * Raw-pointer form of apply. u must not alias x.
+        **/
+        void apply(const float *x, float ts, float *u, arma::uword n) const;
+
+        static std::vector<float> savitzky_golay_coefficients(unsigned int order,
+            unsigned int window, int pos=0);
+
+    private:
+        method m_method;
+        unsigned int m_order;
+        unsigned int m_window;
+
+        std::vector<float> m_centre;
+        std::vector<std::vector<float>> m_edges;
+
+        void fir(const float *x, float inv_ts, float *u, arma::uword n) const;
+
+        template <unsigned int taps>
+        static void fir_pass(const float *x, const float *c, arma::uword j, 
+            float *u, arma::uword begin, arma::uword end);
+};
+
+
+Differentiator::Differentiator(method type, unsigned int order,
+    unsigned int window) : m_method(type), m_order(order), m_window(window)
+{
+    if (m_method == method::central_diff)
+    {
+        m_order = 1; m_window = 3;
+        m_centre = {-0.5f, 0.0f, 0.5f};
+        return;
+    }
+
+    if (m_window % 2 == 0 || m_window < 3 || m_order < 1 || m_order >= m_window)
+    {
+        throw std::invalid_argument("Savitzky-Golay differentiator: the window "
+            "must be odd and greater than the order");
+    }
+
+    const int half = m_window / 2;
+    m_centre = savitzky_golay_coefficients(m_order, m_window, 0);
+
+    // The first and last half window samples are fitted off-centre
+    for (int pos = -half; pos <= half; pos++)
+    {
+        if (pos == 0) { continue; }
+        m_edges.push_back(savitzky_golay_coefficients(m_order, m_window, pos));
+    }
+}
+
+/**************** Methods *****************/
+
+/**
+ * Least-squares derivative coefficients at position pos (-m <= pos <= m) of a
+ * window of 2m + 1 samples with unit spacing. The abscissae are normalised to
+ * [-1, 1] so the normal equations stay well conditioned for wide windows.
+ * @param order Polynomial order
+ * @param window Odd window length
+ * @param pos Evaluation position relative to the window centre
+ * @return Coefficients in window order
+*/
+std::vector<float> Differentiator::savitzky_golay_coefficients(unsigned int order,
+    unsigned int window, int pos)
+{
+    const int half = window / 2;
+    const double scale = 1.0 / half;
+
+    arma::mat vander(window, order + 1);
+    for (unsigned int i = 0; i < window; i++)
+    {
+        const double z = (double(i) - half) * scale;
+        double zp = 1.0;
+        for (unsigned int j = 0; j <= order; j++) { vander.at(i, j) = zp; zp *= z; }
+    }
+
+    // Rows of the fit operator: polynomial coefficient j from the samples
+    arma::mat fit = arma::solve(vander.t() * vander, vander.t());
+
+    // Derivative of the fitted polynomial at pos
+    const double z0 = pos * scale;
+    std::vector<float> coef(window, 0.0f);
+
+    for (unsigned int k = 0; k < window; k++)
+    {
+        double d = 0.0; double zp = 1.0;
+        for (unsigned int j = 1; j <= order; j++)
+        {
+            d += j * zp * fit.at(j, k); zp *= z0;
+        }
+        coef[k] = d * scale;
+    }
+
+    return coef;
+}
+
+
+void Differentiator::apply(const arma::fvec &x_vec, float ts, arma::fvec *u_vec) const
+{
+    if (u_vec == &x_vec)
+    {
+        arma::fvec u_tmp; apply(x_vec, ts, &u_tmp);
+        u_vec->steal_mem(u_tmp); return;
+    }
+
+    u_vec->set_size(x_vec.n_elem);
+    apply(x_vec.memptr(), ts, u_vec->memptr(), x_vec.n_elem);
+}
+
+void Differentiator::apply(const float *x, float ts, float *u, arma::uword n) const
+{
+    if (m_method == method::central_diff || n < m_window)
+    {
+        ArmaExt::central_diff_uniform<float>(x, ts, u, n);
+        return;
+    }
+
+    const float inv_ts = 1.0f / ts;
+    const arma::uword half = m_window / 2;
+
+    // Edges: off-centre fits over the first and last window
+    for (arma::uword e = 0; e < half; e++)
+    {
+        const std::vector<float> &head = m_edges[e];
+        const std::vector<float> &tail = m_edges[half + e];
+        const float *x_tail = x + n - m_window;
+
+        float u_head = 0.0f; float u_tail = 0.0f;
+        for (arma::uword k = 0; k < m_window; k++)
+        {
+            u_head += head[k] * x[k]; u_tail += tail[k] * x_tail[k];
+        }
+        u[e] = u_head * inv_ts; u[n - half + e] = u_tail * inv_ts;
+    }
+
+    fir(x, inv_ts, u, n);
+}
+
+/**
+ * Interior of the window centre convolution. The derivative coefficients are
+ * antisymmetric, so each tap pair costs one subtraction and one multiply-add.
+ * The output is produced in blocks that stay in the L1 cache while the taps
+ * are accumulated, four taps per contiguous, vectorisable pass.
+*/
+void Differentiator::fir(const float *x, float inv_ts, float *u, arma::uword n) const
+{
+    const arma::uword half = m_window / 2;
+    const arma::uword block = 2048;
+
+    std::vector<float> c(half + 1, 0.0f);
+    for (arma::uword j = 1; j <= half; j++) { c[j] = m_centre[half + j] * inv_ts; }
+
+    for (arma::uword begin = half; begin < n - half; begin += block)
+    {
+        const arma::uword end = std::min(begin + block, n - half);
+        std::fill(u + begin, u + end, 0.0f);
+
+        // Up to four taps per pass over the block
+        arma::uword j = 1;
+        for (; j + 3 <= half; j += 4) { fir_pass<4>(x, &c[j], j, u, begin, end); }
+
+        switch (half - j + 1)
+        {
+            case 3: fir_pass<3>(x, &c[j], j, u, begin, end); break;
+            case 2: fir_pass<2>(x, &c[j], j, u, begin, end); break;
+            case 1: fir_pass<1>(x, &c[j], j, u, begin, end); break;
+            default: break;
+        }
+    }
+}
+
+/**
+ * Accumulates the taps j ... j + taps - 1 of coefficients c over [begin, end).
+*/
+template <unsigned int taps>
+void Differentiator::fir_pass(const float *x, const float *c, arma::uword j, 
+    float *u, arma::uword begin, arma::uword end)
+{
+    // Local copy, the compiler cannot assume that u does not alias c
+    float ck[taps];
+    for (unsigned int k = 0; k < taps; k++) { ck[k] = c[k]; }
+
+    for (arma::uword i = begin; i < end; i++)
+    {
+        float acc = 0.0f;
+        for (unsigned int k = 0; k < taps; k++)
+        {
+            acc += ck[k] * (x[i + j + k] - x[i - j - k]);
+        }
+        u[i] += acc;
+    }
+}
+
+#endif
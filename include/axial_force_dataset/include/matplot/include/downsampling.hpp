@@ -0,0 +1,174 @@
+#ifndef DOWNSAMPLING_H
+#define DOWNSAMPLING_H
+
+#include <cmath>
+#include <cstddef>
+
+
+/**
+ * Point reduction of (x, y) series before plotting. Both kernels are linear
+ * in the number of samples and keep the first and the last point. M is an
+ * Armadillo vector type (Col or Row).
+**/
+class Downsampling
+{
+    public:
+        enum class method {none, lttb, minmax};
+
+        Downsampling() {};
+
+        /**
+         * Reduces the series with the selected method when it holds more
+         * than max_points samples, otherwise the outputs are plain copies.
+         * @param max_points Point budget (0 disables the reduction).
+        **/
+        template <class M>
+        static void reduce(const M &x, const M &y, size_t max_points,
+            method mode, M *x_out, M *y_out);
+
+        template <class M>
+        static void lttb(const M &x, const M &y, size_t threshold,
+            M *x_out, M *y_out);
+
+        template <class M>
+        static void minmax(const M &x, const M &y, size_t threshold,
+            M *x_out, M *y_out);
+
+    private:
+        static size_t bucket_begin(size_t bucket, double every);
+};
+
+
+template <class M>
+void Downsampling::reduce(const M &x, const M &y, size_t max_points,
+    method mode, M *x_out, M *y_out)
+{
+    size_t n = (x.n_elem < y.n_elem) ? x.n_elem : y.n_elem;
+
+    if (mode == method::none || max_points == 0 || n <= max_points)
+    {
+        *x_out = x; *y_out = y;
+    }
+    else if (mode == method::lttb) { lttb(x, y, max_points, x_out, y_out); }
+    else { minmax(x, y, max_points, x_out, y_out); }
+}
+
+
+/**
+ * Largest-Triangle-Three-Buckets: the samples between the first and the last
+ * one are split into threshold-2 buckets and, for each bucket, the point
+ * forming the largest triangle with the previously selected point and the
+ * average of the next bucket is kept.
+ * @param threshold Number of output points (at least 3).
+*/
+template <class M>
+void Downsampling::lttb(const M &x, const M &y, size_t threshold,
+    M *x_out, M *y_out)
+{
+    typedef typename M::elem_type eT;
+
+    size_t n = (x.n_elem < y.n_elem) ? x.n_elem : y.n_elem;
+    if (threshold < 3 || n <= threshold) { *x_out = x; *y_out = y; return; }
+
+    const eT *px = x.memptr(); const eT *py = y.memptr();
+    x_out->set_size(threshold); y_out->set_size(threshold);
+    eT *ox = x_out->memptr(); eT *oy = y_out->memptr();
+
+    const double every = (double) (n - 2) / (threshold - 2);
+    size_t a = 0;
+    ox[0] = px[0]; oy[0] = py[0];
+
+    for (size_t b = 0; b < threshold - 2; b++)
+    {
+        // Average of the next bucket (the last point for the final bucket)
+        size_t next_begin = bucket_begin(b + 1, every);
+        size_t next_end = (b + 2 < threshold - 2) ?
+            bucket_begin(b + 2, every) : n - 1;
+        if (b + 1 == threshold - 2) { next_begin = n - 1; next_end = n; }
+
+        double avg_x = 0; double avg_y = 0;
+        for (size_t i = next_begin; i < next_end; i++)
+        {
+            avg_x += px[i]; avg_y += py[i];
+        }
+        avg_x /= (next_end - next_begin); avg_y /= (next_end - next_begin);
+
+        // Point of the current bucket with the largest triangle
+        const size_t begin = bucket_begin(b, every);
+        const size_t end = (b + 1 < threshold - 2) ?
+            bucket_begin(b + 1, every) : n - 1;
+        const double ax = px[a]; const double ay = py[a];
+
+        double max_area = -1; size_t max_i = begin;
+        for (size_t i = begin; i < end; i++)
+        {
+            double area = std::fabs((ax - avg_x) * (py[i] - ay) -
+                (ax - px[i]) * (avg_y - ay));
+            if (area > max_area) { max_area = area; max_i = i; }
+        }
+
+        ox[b + 1] = px[max_i]; oy[b + 1] = py[max_i];
+        a = max_i;
+    }
+
+    ox[threshold - 1] = px[n - 1]; oy[threshold - 1] = py[n - 1];
+}
+
+
+/**
+ * Min/max decimation: the samples between the first and the last one are
+ * split into (threshold-2)/2 buckets and the minimum and the maximum of y
+ * of every bucket are kept in their original order. Peaks are preserved
+ * exactly, which suits force channels.
+ * @param threshold Maximum number of output points (at least 4).
+*/
+template <class M>
+void Downsampling::minmax(const M &x, const M &y, size_t threshold,
+    M *x_out, M *y_out)
+{
+    typedef typename M::elem_type eT;
+
+    size_t n = (x.n_elem < y.n_elem) ? x.n_elem : y.n_elem;
+    if (threshold < 4 || n <= threshold) { *x_out = x; *y_out = y; return; }
+
+    const eT *px = x.memptr(); const eT *py = y.memptr();
+    const size_t buckets = (threshold - 2) / 2;
+    x_out->set_size(2 * buckets + 2); y_out->set_size(2 * buckets + 2);
+    eT *ox = x_out->memptr(); eT *oy = y_out->memptr();
+
+    const double every = (double) (n - 2) / buckets;
+    size_t k = 0;
+    ox[k] = px[0]; oy[k] = py[0]; k++;
+
+    for (size_t b = 0; b < buckets; b++)
+    {
+        const size_t begin = bucket_begin(b, every);
+        const size_t end = (b + 1 < buckets) ? bucket_begin(b + 1, every) : n - 1;
+
+        size_t i_min = begin; size_t i_max = begin;
+        for (size_t i = begin + 1; i < end; i++)
+        {
+            if (py[i] < py[i_min]) { i_min = i; }
+            if (py[i] > py[i_max]) { i_max = i; }
+        }
+
+        size_t first = (i_min < i_max) ? i_min : i_max;
+        size_t second = (i_min < i_max) ? i_max : i_min;
+        ox[k] = px[first]; oy[k] = py[first]; k++;
+        ox[k] = px[second]; oy[k] = py[second]; k++;
+    }
+
+    ox[k] = px[n - 1]; oy[k] = py[n - 1];
+}
+
+
+/**
+ * First sample of a bucket (bucket 0 starts after the first point).
+*/
+size_t Downsampling::bucket_begin(size_t bucket, double every)
+{
+    return (size_t) std::floor(bucket * every) + 1;
+}
+
+
+#endif
@@ -0,0 +1,801 @@
+#ifndef NATIVE_FIGURE_H
+#define NATIVE_FIGURE_H
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cctype>
+#include <fstream>
+#include <algorithm>
+
+#include "raster_canvas.hpp"
+
+
+/**
+ * Interpreter-free figure used by the native MatPlot backend. It keeps the
+ * plotted series of a subplot grid and writes them as SVG or PNG with the
+ * matplotlib defaults (640x480 px, subplot margins, tab10 colour cycle).
+ * Independent figures share no state and can be rendered concurrently.
+**/
+class NativeFigure
+{
+    public:
+        NativeFigure(int width=640, int height=480);
+
+        /**
+         * Selects (and creates if needed) the axes of a rows x cols grid.
+         * @param index One-based row-major position.
+        **/
+        void subplot(int rows, int cols, int index);
+
+        /**
+         * Adds a series to the current axes.
+         * @param fmt matplotlib format string ([colour][marker][line]).
+        **/
+        template <typename eT>
+        void plot(const eT *x, const eT *y, size_t n, const std::string &fmt,
+            double linewidth, double markersize, const std::string &label);
+
+        void set_xlabel(const std::string &text, int fontsize, const std::string &font);
+        void set_ylabel(const std::string &text, int fontsize, const std::string &font);
+        void set_title(const std::string &text, int fontsize, const std::string &font);
+
+        /**
+         * Toggles the grid of the current axes (as plt.grid()).
+        **/
+        void grid(void);
+
+        /**
+         * Writes the figure, the format is selected by the extension
+         * (.svg or .png).
+         * @return False if the format is unknown or the file cannot be written.
+        **/
+        bool savefig(const std::string &filename) const;
+        bool save_svg(const std::string &filename) const;
+        bool save_png(const std::string &filename) const;
+
+    private:
+        struct Text
+        {
+            std::string text;
+            int fontsize = 11;
+            std::string font = "serif";
+        };
+
+        struct Series
+        {
+            std::vector<double> x, y;
+            PlotColor color;
+            bool line = true;
+            std::vector<double> dash; /// On/off lengths in units of linewidth.
+            char marker = 0;
+            double linewidth = 1.5; /// Points.
+            double markersize = 6; /// Points.
+            std::string label;
+        };
+
+        struct Axes
+        {
+            int rows = 1, cols = 1, index = 1;
+            std::vector<Series> series;
+            Text xlabel, ylabel, title;
+            bool grid = false;
+            size_t color_cycle = 0;
+        };
+
+        // Pixel rectangle and data limits of an axes
+        struct Frame
+        {
+            double left, top, right, bottom;
+            double xmin, xmax, ymin, ymax;
+            std::vector<double> xticks, yticks;
+            double xstep, ystep;
+
+            double px(double x) const {
+                return left + (x - xmin) / (xmax - xmin) * (right - left);
+            }
+            double py(double y) const {
+                return bottom - (y - ymin) / (ymax - ymin) * (bottom - top);
+            }
+        };
+
+        const double m_dpi = 100;
+        const int m_tick_fontsize = 10;
+
+        int m_width;
+        int m_height;
+        std::vector<Axes> m_axes;
+        size_t m_current = 0;
+
+        Axes &current_axes(void);
+        Frame layout(const Axes &axes) const;
+        double pt(double points) const { return points * m_dpi / 72.0; }
+
+        static void parse_fmt(const std::string &fmt, Series *series,
+            bool *has_color);
+        static std::vector<double> nice_ticks(double lo, double hi, double *step);
+        static void data_limits(const std::vector<double> &v, double *lo,
+            double *hi);
+        static std::string tick_label(double val, double step);
+        static std::string plain_text(const std::string &text);
+        static std::string xml_escape(const std::string &text);
+        static std::string svg_color(PlotColor color);
+        static int text_scale(double pixels);
+};
+
+
+NativeFigure::NativeFigure(int width, int height) : m_width(width),
+    m_height(height)
+{
+}
+
+/**************** Methods *****************/
+
+void NativeFigure::subplot(int rows, int cols, int index)
+{
+    for (size_t i = 0; i < m_axes.size(); i++)
+    {
+        if (m_axes[i].rows == rows && m_axes[i].cols == cols &&
+            m_axes[i].index == index)
+        {
+            m_current = i;
+            return;
+        }
+    }
+
+    Axes axes;
+    axes.rows = rows; axes.cols = cols; axes.index = index;
+    m_axes.push_back(axes);
+    m_current = m_axes.size() - 1;
+}
+
+NativeFigure::Axes &NativeFigure::current_axes(void)
+{
+    if (m_axes.empty()) { m_axes.push_back(Axes()); m_current = 0; }
+    return m_axes[m_current];
+}
+
+template <typename eT>
+void NativeFigure::plot(const eT *x, const eT *y, size_t n,
+    const std::string &fmt, double linewidth, double markersize,
+    const std::string &label)
+{
+    static const PlotColor cycle[10] = {{31, 119, 180}, {255, 127, 14},
+        {44, 160, 44}, {214, 39, 40}, {148, 103, 189}, {140, 86, 75},
+        {227, 119, 194}, {127, 127, 127}, {188, 189, 34}, {23, 190, 207}};
+
+    Axes &axes = current_axes();
+    Series series;
+    series.x.assign(x, x + n); series.y.assign(y, y + n);
+    series.linewidth = linewidth; series.markersize = markersize;
+    series.label = label;
+
+    bool has_color = false;
+    parse_fmt(fmt, &series, &has_color);
+    if (!has_color) { series.color = cycle[axes.color_cycle++ % 10]; }
+
+    axes.series.push_back(series);
+}
+
+void NativeFigure::set_xlabel(const std::string &text, int fontsize,
+    const std::string &font)
+{
+    Text &label = current_axes().xlabel;
+    label.text = text; label.fontsize = fontsize; label.font = font;
+}
+
+void NativeFigure::set_ylabel(const std::string &text, int fontsize,
+    const std::string &font)
+{
+    Text &label = current_axes().ylabel;
+    label.text = text; label.fontsize = fontsize; label.font = font;
+}
+
+void NativeFigure::set_title(const std::string &text, int fontsize,
+    const std::string &font)
+{
+    Text &label = current_axes().title;
+    label.text = text; label.fontsize = fontsize; label.font = font;
+}
+
+void NativeFigure::grid(void)
+{
+    Axes &axes = current_axes();
+    axes.grid = !axes.grid;
+}
+
+bool NativeFigure::savefig(const std::string &filename) const
+{
+    std::string ext = filename.substr(filename.find_last_of('.') + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    if (ext == "svg") { return save_svg(filename); }
+    if (ext == "png") { return save_png(filename); }
+    return false;
+}
+
+
+/**
+ * Axes position of the matplotlib subplot grid (left 0.125, right 0.9,
+ * bottom 0.11, top 0.88, wspace and hspace 0.2) and limits padded by 5%.
+*/
+NativeFigure::Frame NativeFigure::layout(const Axes &axes) const
+{
+    const double left = 0.125 * m_width; const double right = 0.9 * m_width;
+    const double top = 0.12 * m_height; const double bottom = 0.89 * m_height;
+
+    const double cell_w = (right - left) / (axes.cols + 0.2 * (axes.cols - 1));
+    const double cell_h = (bottom - top) / (axes.rows + 0.2 * (axes.rows - 1));
+    const int row = (axes.index - 1) / axes.cols;
+    const int col = (axes.index - 1) % axes.cols;
+
+    Frame frame;
+    frame.left = left + col * 1.2 * cell_w; frame.right = frame.left + cell_w;
+    frame.top = top + row * 1.2 * cell_h; frame.bottom = frame.top + cell_h;
+
+    std::vector<double> xs, ys;
+    for (size_t s = 0; s < axes.series.size(); s++)
+    {
+        xs.insert(xs.end(), axes.series[s].x.begin(), axes.series[s].x.end());
+        ys.insert(ys.end(), axes.series[s].y.begin(), axes.series[s].y.end());
+    }
+    data_limits(xs, &frame.xmin, &frame.xmax);
+    data_limits(ys, &frame.ymin, &frame.ymax);
+
+    frame.xticks = nice_ticks(frame.xmin, frame.xmax, &frame.xstep);
+    frame.yticks = nice_ticks(frame.ymin, frame.ymax, &frame.ystep);
+    return frame;
+}
+
+
+/**
+ * The PNG output is rasterised at 100 dpi with the built-in 5x7 font, so the
+ * text sizes are approximated by integer font scales.
+*/
+bool NativeFigure::save_png(const std::string &filename) const
+{
+    const PlotColor black = {0, 0, 0};
+    const PlotColor grid_color = {176, 176, 176};
+
+    RasterCanvas canvas(m_width, m_height);
+    const int tick_scale = text_scale(pt(m_tick_fontsize));
+
+    for (size_t a = 0; a < m_axes.size(); a++)
+    {
+        const Axes &axes = m_axes[a];
+        const Frame f = layout(axes);
+
+        canvas.set_clip((int) f.left, (int) f.top, (int) std::ceil(f.right),
+            (int) std::ceil(f.bottom));
+
+        if (axes.grid)
+        {
+            for (size_t i = 0; i < f.xticks.size(); i++)
+            {
+                canvas.draw_line(f.px(f.xticks[i]), f.top, f.px(f.xticks[i]),
+                    f.bottom, pt(0.8), grid_color);
+            }
+            for (size_t i = 0; i < f.yticks.size(); i++)
+            {
+                canvas.draw_line(f.left, f.py(f.yticks[i]), f.right,
+                    f.py(f.yticks[i]), pt(0.8), grid_color);
+            }
+        }
+
+        for (size_t s = 0; s < axes.series.size(); s++)
+        {
+            const Series &series = axes.series[s];
+            const double width = pt(series.linewidth);
+
+            std::vector<double> dash(series.dash);
+            for (size_t i = 0; i < dash.size(); i++) { dash[i] *= width; }
+
+            double covered = 0;
+            for (size_t i = 1; series.line && i < series.x.size(); i++)
+            {
+                double x0 = f.px(series.x[i - 1]); double y0 = f.py(series.y[i - 1]);
+                double x1 = f.px(series.x[i]); double y1 = f.py(series.y[i]);
+                if (!std::isfinite(x0 + y0 + x1 + y1)) { continue; }
+
+                canvas.draw_line(x0, y0, x1, y1, width, series.color, dash,
+                    covered);
+                covered += std::hypot(x1 - x0, y1 - y0);
+            }
+
+            const double r = 0.5 * pt(series.markersize);
+            for (size_t i = 0; series.marker && i < series.x.size(); i++)
+            {
+                double x = f.px(series.x[i]); double y = f.py(series.y[i]);
+                if (!std::isfinite(x + y)) { continue; }
+
+                switch (series.marker)
+                {
+                    case '.': canvas.fill_circle(x, y, 0.5 * r, series.color); break;
+                    case 's': canvas.fill_rect(x - r, y - r, x + r, y + r, series.color); break;
+                    case '+': case '*':
+                        canvas.draw_line(x - r, y, x + r, y, pt(1), series.color);
+                        canvas.draw_line(x, y - r, x, y + r, pt(1), series.color);
+                        if (series.marker == '+') { break; }
+                        // '*' adds the diagonals of 'x'
+                    case 'x':
+                        canvas.draw_line(x - 0.7 * r, y - 0.7 * r, x + 0.7 * r,
+                            y + 0.7 * r, pt(1), series.color);
+                        canvas.draw_line(x - 0.7 * r, y + 0.7 * r, x + 0.7 * r,
+                            y - 0.7 * r, pt(1), series.color);
+                        break;
+                    default: canvas.fill_circle(x, y, r, series.color);
+                }
+            }
+        }
+
+        canvas.reset_clip();
+
+        // Spines, ticks and tick labels
+        const double spine = pt(0.8); const double tick = pt(3.5);
+        canvas.draw_line(f.left, f.top, f.right, f.top, spine, black);
+        canvas.draw_line(f.left, f.bottom, f.right, f.bottom, spine, black);
+        canvas.draw_line(f.left, f.top, f.left, f.bottom, spine, black);
+        canvas.draw_line(f.right, f.top, f.right, f.bottom, spine, black);
+
+        int ytick_width = 0;
+        for (size_t i = 0; i < f.xticks.size(); i++)
+        {
+            double x = f.px(f.xticks[i]);
+            canvas.draw_line(x, f.bottom, x, f.bottom + tick, spine, black);
+            canvas.draw_text(x, f.bottom + tick + pt(3.5),
+                tick_label(f.xticks[i], f.xstep), tick_scale, black, 0.5, 0);
+        }
+        for (size_t i = 0; i < f.yticks.size(); i++)
+        {
+            double y = f.py(f.yticks[i]);
+            std::string label = tick_label(f.yticks[i], f.ystep);
+            canvas.draw_line(f.left - tick, y, f.left, y, spine, black);
+            canvas.draw_text(f.left - tick - pt(3.5), y, label, tick_scale,
+                black, 1, 0.5);
+            ytick_width = std::max(ytick_width,
+                RasterCanvas::text_width(label, tick_scale));
+        }
+
+        // Labels and title
+        const double tick_text_h = RasterCanvas::text_height(tick_scale);
+        if (!axes.xlabel.text.empty())
+        {
+            canvas.draw_text(0.5 * (f.left + f.right), f.bottom + tick +
+                pt(7) + tick_text_h, plain_text(axes.xlabel.text),
+                text_scale(pt(axes.xlabel.fontsize)), black, 0.5, 0);
+        }
+        if (!axes.ylabel.text.empty())
+        {
+            int scale = text_scale(pt(axes.ylabel.fontsize));
+            canvas.draw_text(f.left - tick - pt(7) - ytick_width -
+                RasterCanvas::text_height(scale), 0.5 * (f.top + f.bottom),
+                plain_text(axes.ylabel.text), scale, black, 0.5, 0, true);
+        }
+        if (!axes.title.text.empty())
+        {
+            canvas.draw_text(0.5 * (f.left + f.right), f.top - pt(6),
+                plain_text(axes.title.text),
+                text_scale(pt(axes.title.fontsize)), black, 0.5, 1);
+        }
+
+        // Legend (upper right corner)
+        std::vector<const Series *> entries;
+        int legend_w = 0;
+        for (size_t s = 0; s < axes.series.size(); s++)
+        {
+            if (axes.series[s].label.empty()) { continue; }
+            entries.push_back(&axes.series[s]);
+            legend_w = std::max(legend_w, RasterCanvas::text_width(
+                plain_text(axes.series[s].label), tick_scale));
+        }
+
+        if (!entries.empty())
+        {
+            const double row_h = tick_text_h + pt(5);
+            const double x1 = f.right - pt(5); const double y0 = f.top + pt(5);
+            const double x0 = x1 - legend_w - pt(30);
+            const double y1 = y0 + entries.size() * row_h + pt(4);
+
+            canvas.fill_rect(x0, y0, x1, y1, {255, 255, 255});
+            canvas.draw_line(x0, y0, x1, y0, pt(0.5), {204, 204, 204});
+            canvas.draw_line(x0, y1, x1, y1, pt(0.5), {204, 204, 204});
+            canvas.draw_line(x0, y0, x0, y1, pt(0.5), {204, 204, 204});
+            canvas.draw_line(x1, y0, x1, y1, pt(0.5), {204, 204, 204});
+
+            for (size_t e = 0; e < entries.size(); e++)
+            {
+                double y = y0 + pt(2) + (e + 0.5) * row_h;
+                canvas.draw_line(x0 + pt(4), y, x0 + pt(20), y,
+                    pt(entries[e]->linewidth), entries[e]->color);
+                canvas.draw_text(x0 + pt(25), y, plain_text(entries[e]->label),
+                    tick_scale, black, 0, 0.5);
+            }
+        }
+    }
+
+    return canvas.save_png(filename);
+}
+
+
+bool NativeFigure::save_svg(const std::string &filename) const
+{
+    std::ofstream file(filename.c_str());
+    if (!file.is_open()) { return false; }
+
+    char buf[256];
+    file << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+        << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << m_width
+        << "\" height=\"" << m_height << "\" viewBox=\"0 0 " << m_width << " "
+        << m_height << "\">\n<rect width=\"100%\" height=\"100%\" "
+        << "fill=\"#ffffff\"/>\n";
+
+    for (size_t a = 0; a < m_axes.size(); a++)
+    {
+        const Axes &axes = m_axes[a];
+        const Frame f = layout(axes);
+        const double tick = pt(3.5);
+
+        std::snprintf(buf, sizeof(buf), "<clipPath id=\"axes%u\"><rect x=\"%.2f\" "
+            "y=\"%.2f\" width=\"%.2f\" height=\"%.2f\"/></clipPath>\n",
+            (unsigned) a, f.left, f.top, f.right - f.left, f.bottom - f.top);
+        file << buf;
+
+        if (axes.grid)
+        {
+            file << "<g stroke=\"#b0b0b0\" stroke-width=\"" << pt(0.8) << "\">\n";
+            for (size_t i = 0; i < f.xticks.size(); i++)
+            {
+                std::snprintf(buf, sizeof(buf), "<line x1=\"%.2f\" y1=\"%.2f\" "
+                    "x2=\"%.2f\" y2=\"%.2f\"/>\n", f.px(f.xticks[i]), f.top,
+                    f.px(f.xticks[i]), f.bottom);
+                file << buf;
+            }
+            for (size_t i = 0; i < f.yticks.size(); i++)
+            {
+                std::snprintf(buf, sizeof(buf), "<line x1=\"%.2f\" y1=\"%.2f\" "
+                    "x2=\"%.2f\" y2=\"%.2f\"/>\n", f.left, f.py(f.yticks[i]),
+                    f.right, f.py(f.yticks[i]));
+                file << buf;
+            }
+            file << "</g>\n";
+        }
+
+        file << "<g clip-path=\"url(#axes" << a << ")\">\n";
+        for (size_t s = 0; s < axes.series.size(); s++)
+        {
+            const Series &series = axes.series[s];
+            const std::string color = svg_color(series.color);
+            const double width = pt(series.linewidth);
+
+            if (series.line)
+            {
+                file << "<polyline fill=\"none\" stroke=\"" << color
+                    << "\" stroke-width=\"" << width << "\" stroke-linejoin=\"round\"";
+                if (!series.dash.empty())
+                {
+                    file << " stroke-dasharray=\"";
+                    for (size_t i = 0; i < series.dash.size(); i++)
+                    {
+                        file << ((i > 0) ? "," : "") << series.dash[i] * width;
+                    }
+                    file << "\"";
+                }
+                file << " points=\"";
+
+                // Non-finite samples split the line
+                bool first = true;
+                for (size_t i = 0; i < series.x.size(); i++)
+                {
+                    double x = f.px(series.x[i]); double y = f.py(series.y[i]);
+                    if (!std::isfinite(x + y))
+                    {
+                        if (!first)
+                        {
+                            file << "\"/>\n<polyline fill=\"none\" stroke=\""
+                                << color << "\" stroke-width=\"" << width
+                                << "\" points=\"";
+                            first = true;
+                        }
+                        continue;
+                    }
+                    std::snprintf(buf, sizeof(buf), "%s%.2f,%.2f",
+                        (first) ? "" : " ", x, y);
+                    file << buf;
+                    first = false;
+                }
+                file << "\"/>\n";
+            }
+
+            if (series.marker)
+            {
+                const double r = 0.5 * pt(series.markersize);
+                file << "<g fill=\"" << color << "\" stroke=\"" << color
+                    << "\" stroke-width=\"" << pt(1) << "\">\n";
+
+                for (size_t i = 0; i < series.x.size(); i++)
+                {
+                    double x = f.px(series.x[i]); double y = f.py(series.y[i]);
+                    if (!std::isfinite(x + y)) { continue; }
+
+                    switch (series.marker)
+                    {
+                        case '.':
+                            std::snprintf(buf, sizeof(buf), "<circle cx=\"%.2f\" "
+                                "cy=\"%.2f\" r=\"%.2f\"/>\n", x, y, 0.5 * r);
+                            break;
+                        case 's':
+                            std::snprintf(buf, sizeof(buf), "<rect x=\"%.2f\" "
+                                "y=\"%.2f\" width=\"%.2f\" height=\"%.2f\"/>\n",
+                                x - r, y - r, 2 * r, 2 * r);
+                            break;
+                        case '+':
+                            std::snprintf(buf, sizeof(buf), "<path d=\"M%.2f %.2fH%.2f"
+                                "M%.2f %.2fV%.2f\"/>\n", x - r, y, x + r, x,
+                                y - r, y + r);
+                            break;
+                        case 'x': case '*':
+                        {
+                            double d = 0.7 * r;
+                            int len = std::snprintf(buf, sizeof(buf), "<path d=\"M%.2f "
+                                "%.2fL%.2f %.2fM%.2f %.2fL%.2f %.2f", x - d, y - d,
+                                x + d, y + d, x - d, y + d, x + d, y - d);
+                            if (series.marker == '*')
+                            {
+                                len += std::snprintf(buf + len, sizeof(buf) - len,
+                                    "M%.2f %.2fH%.2fM%.2f %.2fV%.2f", x - r, y,
+                                    x + r, x, y - r, y + r);
+                            }
+                            std::snprintf(buf + len, sizeof(buf) - len, "\"/>\n");
+                            break;
+                        }
+                        default:
+                            std::snprintf(buf, sizeof(buf), "<circle cx=\"%.2f\" "
+                                "cy=\"%.2f\" r=\"%.2f\"/>\n", x, y, r);
+                    }
+                    file << buf;
+                }
+                file << "</g>\n";
+            }
+        }
+        file << "</g>\n";
+
+        // Spines and ticks
+        std::snprintf(buf, sizeof(buf), "<rect x=\"%.2f\" y=\"%.2f\" width=\"%.2f\" "
+            "height=\"%.2f\" fill=\"none\" stroke=\"#000000\" stroke-width=\"%.2f\"/>\n",
+            f.left, f.top, f.right - f.left, f.bottom - f.top, pt(0.8));
+        file << buf;
+
+        file << "<g font-family=\"sans-serif\" font-size=\"" << pt(m_tick_fontsize)
+            << "\" stroke=\"#000000\" stroke-width=\"" << pt(0.8) << "\">\n";
+        for (size_t i = 0; i < f.xticks.size(); i++)
+        {
+            double x = f.px(f.xticks[i]);
+            std::snprintf(buf, sizeof(buf), "<line x1=\"%.2f\" y1=\"%.2f\" x2=\"%.2f\" "
+                "y2=\"%.2f\"/>\n<text x=\"%.2f\" y=\"%.2f\" stroke=\"none\" "
+                "text-anchor=\"middle\" dominant-baseline=\"hanging\">", x, f.bottom,
+                x, f.bottom + tick, x, f.bottom + tick + pt(3.5));
+            file << buf << tick_label(f.xticks[i], f.xstep) << "</text>\n";
+        }
+        for (size_t i = 0; i < f.yticks.size(); i++)
+        {
+            double y = f.py(f.yticks[i]);
+            std::snprintf(buf, sizeof(buf), "<line x1=\"%.2f\" y1=\"%.2f\" x2=\"%.2f\" "
+                "y2=\"%.2f\"/>\n<text x=\"%.2f\" y=\"%.2f\" stroke=\"none\" "
+                "text-anchor=\"end\" dominant-baseline=\"central\">", f.left - tick,
+                y, f.left, y, f.left - tick - pt(3.5), y);
+            file << buf << tick_label(f.yticks[i], f.ystep) << "</text>\n";
+        }
+        file << "</g>\n";
+
+        // Labels, title and legend
+        const double tick_text_h = pt(m_tick_fontsize);
+        if (!axes.xlabel.text.empty())
+        {
+            std::snprintf(buf, sizeof(buf), "<text x=\"%.2f\" y=\"%.2f\" "
+                "text-anchor=\"middle\" dominant-baseline=\"hanging\" ",
+                0.5 * (f.left + f.right), f.bottom + tick + pt(7) + tick_text_h);
+            file << buf << "font-family=\"" << axes.xlabel.font << "\" font-size=\""
+                << pt(axes.xlabel.fontsize) << "\">"
+                << xml_escape(plain_text(axes.xlabel.text)) << "</text>\n";
+        }
+        if (!axes.ylabel.text.empty())
+        {
+            double x = f.left - tick - pt(7) - 3 * tick_text_h;
+            double y = 0.5 * (f.top + f.bottom);
+            std::snprintf(buf, sizeof(buf), "<text x=\"%.2f\" y=\"%.2f\" "
+                "transform=\"rotate(-90 %.2f %.2f)\" text-anchor=\"middle\" ",
+                x, y, x, y);
+            file << buf << "font-family=\"" << axes.ylabel.font << "\" font-size=\""
+                << pt(axes.ylabel.fontsize) << "\">"
+                << xml_escape(plain_text(axes.ylabel.text)) << "</text>\n";
+        }
+        if (!axes.title.text.empty())
+        {
+            std::snprintf(buf, sizeof(buf), "<text x=\"%.2f\" y=\"%.2f\" "
+                "text-anchor=\"middle\" ", 0.5 * (f.left + f.right), f.top - pt(6));
+            file << buf << "font-family=\"" << axes.title.font << "\" font-size=\""
+                << pt(axes.title.fontsize) << "\">"
+                << xml_escape(plain_text(axes.title.text)) << "</text>\n";
+        }
+
+        size_t entry = 0;
+        for (size_t s = 0; s < axes.series.size(); s++)
+        {
+            const Series &series = axes.series[s];
+            if (series.label.empty()) { continue; }
+
+            double y = f.top + pt(10) + entry * (tick_text_h + pt(5));
+            std::snprintf(buf, sizeof(buf), "<line x1=\"%.2f\" y1=\"%.2f\" x2=\"%.2f\" "
+                "y2=\"%.2f\" stroke-width=\"%.2f\" ", f.right - pt(120), y,
+                f.right - pt(104), y, pt(series.linewidth));
+            file << buf << "stroke=\"" << svg_color(series.color) << "\"/>\n";
+            std::snprintf(buf, sizeof(buf), "<text x=\"%.2f\" y=\"%.2f\" "
+                "dominant-baseline=\"central\" font-family=\"sans-serif\" "
+                "font-size=\"%.2f\">", f.right - pt(99), y, pt(m_tick_fontsize));
+            file << buf << xml_escape(plain_text(series.label)) << "</text>\n";
+            entry++;
+        }
+    }
+
+    file << "</svg>\n";
+    file.close();
+    return !file.fail();
+}
+
+
+/**
+ * Parses a matplotlib format string: colour (bgrcmykw), line style
+ * (-, --, -., :) and marker (. o s + x *, other markers are drawn as o).
+ * A marker without a line style disables the line.
+*/
+void NativeFigure::parse_fmt(const std::string &fmt, Series *series,
+    bool *has_color)
+{
+    static const std::string colors = "bgrcmykw";
+    static const PlotColor values[8] = {{0, 0, 255}, {0, 128, 0}, {255, 0, 0},
+        {0, 191, 191}, {191, 0, 191}, {191, 191, 0}, {0, 0, 0}, {255, 255, 255}};
+    static const std::string markers = ".,ov^<>1234sp*hH+xXDd|_";
+
+    bool has_style = false;
+    *has_color = false;
+
+    for (size_t i = 0; i < fmt.size(); i++)
+    {
+        std::string rest = fmt.substr(i);
+
+        if (rest.compare(0, 2, "--") == 0)
+        {
+            series->dash = {3.7, 1.6}; has_style = true; i++;
+        }
+        else if (rest.compare(0, 2, "-.") == 0)
+        {
+            series->dash = {6.4, 1.6, 1.0, 1.6}; has_style = true; i++;
+        }
+        else if (fmt[i] == '-') { series->dash.clear(); has_style = true; }
+        else if (fmt[i] == ':') { series->dash = {1.0, 1.65}; has_style = true; }
+        else if (colors.find(fmt[i]) != std::string::npos)
+        {
+            series->color = values[colors.find(fmt[i])]; *has_color = true;
+        }
+        else if (markers.find(fmt[i]) != std::string::npos)
+        {
+            series->marker = (fmt[i] == ',') ? '.' : fmt[i];
+        }
+    }
+
+    series->line = has_style || series->marker == 0;
+}
+
+
+/**
+ * Ticks at multiples of 1, 2, 2.5 or 5 times a power of ten, at most 9
+ * inside [lo, hi].
+*/
+std::vector<double> NativeFigure::nice_ticks(double lo, double hi,
+    double *step)
+{
+    static const double steps[4] = {1, 2, 2.5, 5};
+
+    double magnitude = std::pow(10, std::floor(std::log10((hi - lo) / 8)));
+    *step = 10 * magnitude;
+    for (int i = 0; i < 4; i++)
+    {
+        if ((hi - lo) / (steps[i] * magnitude) <= 8) { *step = steps[i] * magnitude; break; }
+    }
+
+    std::vector<double> ticks;
+    for (double t = std::ceil(lo / *step - 1e-9) * *step; t <= hi + 1e-9 * *step;
+        t += *step)
+    {
+        ticks.push_back((std::fabs(t) < 1e-12 * *step) ? 0 : t);
+    }
+    return ticks;
+}
+
+void NativeFigure::data_limits(const std::vector<double> &v, double *lo,
+    double *hi)
+{
+    *lo = INFINITY; *hi = -INFINITY;
+    for (size_t i = 0; i < v.size(); i++)
+    {
+        if (!std::isfinite(v[i])) { continue; }
+        *lo = std::min(*lo, v[i]); *hi = std::max(*hi, v[i]);
+    }
+
+    if (*lo > *hi) { *lo = -0.055; *hi = 0.055; return; }
+    if (*lo == *hi)
+    {
+        double pad = (*lo == 0) ? 0.055 : 0.05 * std::fabs(*lo);
+        *lo -= pad; *hi += pad; return;
+    }
+
+    double pad = 0.05 * (*hi - *lo);
+    *lo -= pad; *hi += pad;
+}
+
+std::string NativeFigure::tick_label(double val, double step)
+{
+    char buf[32];
+    double magnitude = std::max(std::fabs(val), step);
+
+    if (magnitude >= 1e5 || step < 1e-4)
+    {
+        std::snprintf(buf, sizeof(buf), "%g", val);
+    }
+    else
+    {
+        // Enough decimals to tell consecutive ticks apart
+        int decimals = std::max(0, (int) -std::floor(std::log10(step) + 1e-9));
+        if (std::fabs(step / std::pow(10, -decimals) - 2.5) < 1e-6) { decimals++; }
+        std::snprintf(buf, sizeof(buf), "%.*f", decimals, val);
+    }
+    return buf;
+}
+
+/**
+ * Drops the TeX markup of a label ($, \, braces, ^ and _).
+*/
+std::string NativeFigure::plain_text(const std::string &text)
+{
+    std::string plain;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if (std::string("\\${}^_").find(text[i]) != std::string::npos) { continue; }
+        plain += text[i];
+    }
+    return plain;
+}
+
+std::string NativeFigure::xml_escape(const std::string &text)
+{
+    std::string escaped;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        switch (text[i])
+        {
+            case '&': escaped += "&amp;"; break;
+            case '<': escaped += "&lt;"; break;
+            case '>': escaped += "&gt;"; break;
+            case '"': escaped += "&quot;"; break;
+            default: escaped += text[i];
+        }
+    }
+    return escaped;
+}
+
+std::string NativeFigure::svg_color(PlotColor color)
+{
+    char buf[8];
+    std::snprintf(buf, sizeof(buf), "#%02x%02x%02x", color.r, color.g, color.b);
+    return buf;
+}
+
+int NativeFigure::text_scale(double pixels)
+{
+    // The 5x7 glyphs have a cap height of 7 pixels per scale unit
+    return std::max(1, (int) (0.7 * pixels / 7 + 0.3));
+}
+
+
+#endif
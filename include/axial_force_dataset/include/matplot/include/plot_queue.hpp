@@ -0,0 +1,182 @@
+#ifndef PLOT_QUEUE_H
+#define PLOT_QUEUE_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "pythonAPI.hpp"
+
+
+/**
+ * Process-wide plotting worker. Submitted calls are executed in FIFO order
+ * by a dedicated thread; consecutive calls to the same script are batched
+ * into a single Python call. The destructor (at exit) executes the pending
+ * calls before joining the worker. In a forked child (where the worker
+ * thread does not exist) the calls are executed synchronously.
+**/
+class PlotQueue
+{
+    public:
+        static PlotQueue &instance(void);
+
+        /**
+         * Queues a call.
+         * @return Future that is set once the call has run (holding a
+         * std::runtime_error if it failed).
+        **/
+        std::future<void> submit(PythonCall call);
+
+        /**
+         * Blocks until every submitted call has been executed.
+        **/
+        void flush(void);
+
+        ~PlotQueue();
+
+    private:
+        PlotQueue();
+        PlotQueue(const PlotQueue &) = delete;
+        PlotQueue &operator=(const PlotQueue &) = delete;
+
+        struct Entry
+        {
+            PythonCall call;
+            std::promise<void> done;
+        };
+
+        const size_t m_max_batch = 256;
+        const pid_t m_pid;
+
+        std::deque<Entry> m_entries;
+        size_t m_pending = 0;
+        bool m_stop = false;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        std::condition_variable m_idle_cond;
+        std::thread m_worker;
+
+        void worker_loop(void);
+};
+
+
+PlotQueue &PlotQueue::instance(void)
+{
+    static PlotQueue queue;
+    return queue;
+}
+
+PlotQueue::PlotQueue() : m_pid(getpid())
+{
+    m_worker = std::thread(&PlotQueue::worker_loop, this);
+}
+
+std::future<void> PlotQueue::submit(PythonCall call)
+{
+    if (getpid() != m_pid)
+    {
+        std::promise<void> done;
+        std::vector<PythonCall> calls(1, std::move(call));
+        if (PythonAPI::python_batch_call(calls)[0]) { done.set_value(); }
+        else
+        {
+            done.set_exception(std::make_exception_ptr(std::runtime_error(
+                "Python call \"" + calls[0].function_name + "\" failed")));
+        }
+        return done.get_future();
+    }
+
+    Entry entry;
+    entry.call = std::move(call);
+    std::future<void> result = entry.done.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.push_back(std::move(entry));
+        m_pending++;
+    }
+
+    m_cond.notify_one();
+    return result;
+}
+
+void PlotQueue::flush(void)
+{
+    if (getpid() != m_pid) { return; }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle_cond.wait(lock, [this]() { return m_pending == 0; });
+}
+
+void PlotQueue::worker_loop(void)
+{
+    while (true)
+    {
+        std::vector<Entry> batch;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this]() { return m_stop || !m_entries.empty(); });
+
+            if (m_stop && m_entries.empty()) { return; }
+
+            // Consecutive calls of the same script form one batch
+            const PythonCall &first = m_entries.front().call;
+            std::string script_abs_dir = first.script_abs_dir;
+            std::string script_name = first.script_name;
+
+            while (!m_entries.empty() && batch.size() < m_max_batch &&
+                m_entries.front().call.script_abs_dir == script_abs_dir &&
+                m_entries.front().call.script_name == script_name)
+            {
+                batch.push_back(std::move(m_entries.front()));
+                m_entries.pop_front();
+            }
+        }
+
+        std::vector<PythonCall> calls;
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            calls.push_back(std::move(batch[i].call));
+        }
+
+        std::vector<bool> success = PythonAPI::python_batch_call(calls);
+
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            if (success[i]) { batch[i].done.set_value(); }
+            else
+            {
+                batch[i].done.set_exception(std::make_exception_ptr(
+                    std::runtime_error("Python call \"" +
+                    calls[i].function_name + "\" failed")));
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending -= batch.size();
+        }
+        m_idle_cond.notify_all();
+    }
+}
+
+PlotQueue::~PlotQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_cond.notify_all();
+    m_worker.join();
+}
+
+
+#endif
@@ -1,94 +1,359 @@
+
 #ifndef PYTHON_API_H
 #define PYTHON_API_H
 
 #include <Python.h>
 #include <iostream>
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "python_call.hpp"
+
+
+/**
+ * Long-lived embedded interpreter. The interpreter is initialised once and
+ * the imported modules and function handles are cached by name, so repeated
+ * calls only pay for the argument conversion and the call itself. The GIL is
+ * released after initialisation; callers take it with PyGILState_Ensure, so
+ * any thread may call into the session.
+**/
+class PythonSession
+{
+    public:
+        static PythonSession &instance(void);
+
+        PyObject *get_function(const std::string &script_abs_dir,
+            const std::string &script_name, const std::string &function_name);
+
+        /**
+         * fork() support: the GIL is held across fork() so the child starts
+         * from a consistent interpreter.
+         * @return False if the interpreter is not running (nothing to do).
+        **/
+        static bool before_fork(PyGILState_STATE *gil);
+        static void after_fork_parent(PyGILState_STATE gil);
+        static void after_fork_child(PyGILState_STATE gil);
+
+    private:
+        PythonSession();
+        PythonSession(const PythonSession &) = delete;
+        PythonSession &operator=(const PythonSession &) = delete;
+
+        PyObject *get_module(const std::string &script_abs_dir,
+            const std::string &script_name);
+
+        std::set<std::string> m_paths;
+        std::map<std::string, PyObject *> m_modules;
+        std::map<std::string, PyObject *> m_functions;
+};
+
 
 class PythonAPI
 {
     public:
         PythonAPI() {};
 
-        static void python_function_call(std::string script_abs_dir, 
-            std::string script_name, std::string function_name, 
+        static bool python_function_call(std::string script_abs_dir,
+            std::string script_name, std::string function_name,
+            std::string *args, int arg_num);
+
+        /**
+         * Calls a function with the buffers as leading positional arguments,
+         * followed by the string arguments.
+         * @return False if the function is missing or raised.
+        **/
+        static bool python_function_call(std::string script_abs_dir,
+            std::string script_name, std::string function_name,
+            const PythonBuffer *buffers, int buffer_num,
             std::string *args, int arg_num);
+
+        /**
+         * Executes the calls (which share their script) with a single call of
+         * the script's run_batch(calls) function, holding the GIL once.
+         * @return Success flag of every call.
+        **/
+        static std::vector<bool> python_batch_call(
+            const std::vector<PythonCall> &calls);
+
+        /**
+         * Native string of the interpreter (str in Python 2 and 3).
+         * Requires the GIL.
+        **/
+        static PyObject *string_object(const std::string &str);
+
     private:
+        static PyObject *buffer_object(const PythonBuffer &buffer);
+        static PyObject *build_args(const PythonBuffer *buffers,
+            int buffer_num, const std::string *args, int arg_num,
+            const std::string *function_name=NULL);
 };
 
 
-void PythonAPI::python_function_call(std::string script_abs_dir,
-    std::string script_name, std::string function_name, std::string *args, 
-    int arg_num)
+/**
+ * The session lives until the process exits. The cached references are
+ * intentionally kept (the interpreter is never finalised).
+**/
+PythonSession &PythonSession::instance(void)
+{
+    static PythonSession *session = new PythonSession();
+    return *session;
+}
+
+PythonSession::PythonSession()
+{
+    if (!Py_IsInitialized())
+    {
+        Py_Initialize();
+#if PY_MAJOR_VERSION < 3 || (PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION < 7)
+        PyEval_InitThreads();
+#endif
+        PyEval_SaveThread();
+    }
+}
+
+bool PythonSession::before_fork(PyGILState_STATE *gil)
 {
+    if (!Py_IsInitialized()) { return false; }
 
-    PyObject *pName, *pModule, *pFunc;
-    PyObject *pArgs, *pValue;
+    *gil = PyGILState_Ensure();
+#if PY_VERSION_HEX >= 0x03070000
+    PyOS_BeforeFork();
+#endif
+    return true;
+}
 
-    Py_Initialize();
-    PyObject *sysmodule = PyImport_ImportModule("sys");
-    PyObject *syspath = PyObject_GetAttrString(sysmodule, "path");
-    PyList_Append(syspath, PyString_FromString(script_abs_dir.c_str()));
-    Py_DECREF(syspath);
-    Py_DECREF(sysmodule);
+void PythonSession::after_fork_parent(PyGILState_STATE gil)
+{
+#if PY_VERSION_HEX >= 0x03070000
+    PyOS_AfterFork_Parent();
+#endif
+    PyGILState_Release(gil);
+}
 
-    pName = PyString_FromString(script_name.c_str());
-    pModule = PyImport_Import(pName);
+/**
+ * The child keeps the thread state of the forking thread: it only releases
+ * the GIL, as PyGILState_Release could delete the reinitialised state.
+*/
+void PythonSession::after_fork_child(PyGILState_STATE)
+{
+#if PY_VERSION_HEX >= 0x03070000
+    PyOS_AfterFork_Child();
+#else
+    PyOS_AfterFork();
+#endif
+    PyEval_SaveThread();
+}
+
+PyObject *PythonSession::get_module(const std::string &script_abs_dir,
+    const std::string &script_name)
+{
+    std::string key = script_abs_dir + "/" + script_name;
+    std::map<std::string, PyObject *>::iterator it = m_modules.find(key);
+    if (it != m_modules.end()) { return it->second; }
+
+    if (m_paths.insert(script_abs_dir).second)
+    {
+        PyObject *sysmodule = PyImport_ImportModule("sys");
+        PyObject *syspath = PyObject_GetAttrString(sysmodule, "path");
+        PyObject *path = PythonAPI::string_object(script_abs_dir);
+        PyList_Append(syspath, path);
+        Py_DECREF(path);
+        Py_DECREF(syspath);
+        Py_DECREF(sysmodule);
+    }
+
+    PyObject *pName = PythonAPI::string_object(script_name);
+    PyObject *pModule = PyImport_Import(pName);
     Py_DECREF(pName);
 
-    if (pModule != NULL) {
-    
-        pFunc = PyObject_GetAttrString(pModule, function_name.c_str());
-
-        if (pFunc && PyCallable_Check(pFunc)) {
-             
-            pArgs = PyTuple_New(arg_num);        
-
-            for (int i = 0; i < arg_num; ++i) {
-                pValue = PyString_FromString(args[i].c_str());
-                if (!pValue) {
-                    Py_DECREF(pArgs);
-                    Py_DECREF(pModule);
-                    fprintf(stderr, "Cannot convert argument\n");
-                }
-                // Set item
-                PyTuple_SetItem(pArgs, i, pValue);
-            }
+    if (pModule == NULL)
+    {
+        PyErr_Print();
+        fprintf(stderr, "Failed to load \"%s\"\n", script_name.c_str());
+        return NULL;
+    }
 
-            pValue = PyObject_CallObject(pFunc, pArgs);
+    m_modules[key] = pModule;
+    return pModule;
+}
 
-            Py_DECREF(pArgs);
-            if (pValue != NULL) {
-                Py_DECREF(pValue);
-            }
-            else {
-                Py_DECREF(pFunc);
-                Py_DECREF(pModule);
-                PyErr_Print();
-                fprintf(stderr,"Call failed\n");
-            }
+PyObject *PythonSession::get_function(const std::string &script_abs_dir,
+    const std::string &script_name, const std::string &function_name)
+{
+    std::string key = script_abs_dir + "/" + script_name + ":" + function_name;
+    std::map<std::string, PyObject *>::iterator it = m_functions.find(key);
+    if (it != m_functions.end()) { return it->second; }
+
+    PyObject *pModule = get_module(script_abs_dir, script_name);
+    if (pModule == NULL) { return NULL; }
+
+    PyObject *pFunc = PyObject_GetAttrString(pModule, function_name.c_str());
+
+    if (!pFunc || !PyCallable_Check(pFunc))
+    {
+        if (PyErr_Occurred())
+        {
+            PyErr_Print();
         }
-        else 
+        fprintf(stderr, "Cannot find function \"%s\"\n", function_name.c_str());
+        Py_XDECREF(pFunc);
+        return NULL;
+    }
+
+    m_functions[key] = pFunc;
+    return pFunc;
+}
+
+
+bool PythonAPI::python_function_call(std::string script_abs_dir,
+    std::string script_name, std::string function_name, std::string *args,
+    int arg_num)
+{
+    return python_function_call(script_abs_dir, script_name, function_name,
+        NULL, 0, args, arg_num);
+}
+
+bool PythonAPI::python_function_call(std::string script_abs_dir,
+    std::string script_name, std::string function_name,
+    const PythonBuffer *buffers, int buffer_num, std::string *args,
+    int arg_num)
+{
+    PythonSession &session = PythonSession::instance();
+    PyGILState_STATE gil = PyGILState_Ensure();
+
+    bool success = false;
+    PyObject *pFunc = session.get_function(script_abs_dir, script_name,
+        function_name);
+    PyObject *pArgs = (pFunc != NULL) ?
+        build_args(buffers, buffer_num, args, arg_num) : NULL;
+
+    if (pArgs != NULL)
+    {
+        PyObject *pValue = PyObject_CallObject(pFunc, pArgs);
+        Py_DECREF(pArgs);
+
+        if (pValue != NULL) {
+            Py_DECREF(pValue);
+            success = true;
+        }
+        else {
+            PyErr_Print();
+            fprintf(stderr,"Call failed\n");
+        }
+    }
+
+    PyGILState_Release(gil);
+    return success;
+}
+
+std::vector<bool> PythonAPI::python_batch_call(
+    const std::vector<PythonCall> &calls)
+{
+    std::vector<bool> success(calls.size(), false);
+    if (calls.empty()) { return success; }
+
+    PythonSession &session = PythonSession::instance();
+    PyGILState_STATE gil = PyGILState_Ensure();
+
+    PyObject *pFunc = session.get_function(calls[0].script_abs_dir,
+        calls[0].script_name, "run_batch");
+    PyObject *pList = (pFunc != NULL) ? PyList_New(calls.size()) : NULL;
+
+    for (size_t i = 0; pList != NULL && i < calls.size(); i++)
+    {
+        const PythonCall &call = calls[i];
+
+        std::vector<PythonBuffer> buffers;
+        for (size_t k = 0; k < call.buffers.size(); k++)
         {
-            if (PyErr_Occurred())
-            {
-                PyErr_Print();
+            buffers.push_back(PythonBuffer{call.buffers[k].data(),
+                call.buffers[k].size(), ""});
+        }
+
+        PyObject *pCall = build_args(buffers.data(), buffers.size(),
+            call.args.data(), call.args.size(), &call.function_name);
+        if (pCall == NULL) { Py_DECREF(pList); pList = NULL; break; }
+
+        // Set item (steals the reference)
+        PyList_SetItem(pList, i, pCall);
+    }
+
+    if (pList != NULL)
+    {
+        PyObject *pArgs = PyTuple_New(1);
+        PyTuple_SetItem(pArgs, 0, pList);
+        PyObject *pValue = PyObject_CallObject(pFunc, pArgs);
+        Py_DECREF(pArgs);
 
+        if (pValue != NULL && PyList_Check(pValue)) {
+            for (size_t i = 0; i < calls.size() &&
+                i < (size_t) PyList_Size(pValue); i++)
+            {
+                success[i] = PyObject_IsTrue(PyList_GetItem(pValue, i)) == 1;
             }
-            fprintf(stderr, "Cannot find function \"%s\"\n", function_name.c_str());
         }
-
-        Py_XDECREF(pFunc);
-        Py_DECREF(pModule);
+        else if (pValue == NULL) {
+            PyErr_Print();
+            fprintf(stderr,"Call failed\n");
+        }
+        Py_XDECREF(pValue);
     }
 
+    PyGILState_Release(gil);
+    return success;
+}
 
-    else {
-        PyErr_Print();
-        fprintf(stderr, "Failed to load \"%s\"\n", script_name.c_str());
+/**
+ * Builds the argument tuple (buffers first, then strings). When a function
+ * name is given it is prepended, as expected by run_batch.
+ * Requires the GIL.
+*/
+PyObject *PythonAPI::build_args(const PythonBuffer *buffers, int buffer_num,
+    const std::string *args, int arg_num, const std::string *function_name)
+{
+    int offset = (function_name != NULL) ? 1 : 0;
+    PyObject *pArgs = PyTuple_New(offset + buffer_num + arg_num);
+
+    if (function_name != NULL)
+    {
+        PyTuple_SetItem(pArgs, 0, string_object(*function_name));
+    }
+
+    for (int i = 0; i < buffer_num + arg_num; ++i) {
+        PyObject *pValue = (i < buffer_num) ? buffer_object(buffers[i]) :
+            string_object(args[i - buffer_num]);
+        if (!pValue) {
+            Py_DECREF(pArgs);
+            PyErr_Clear();
+            fprintf(stderr, "Cannot convert argument\n");
+            return NULL;
+        }
+        // Set item (steals the reference)
+        PyTuple_SetItem(pArgs, offset + i, pValue);
     }
 
-    // Py_Finalize();
+    return pArgs;
+}
+
+PyObject *PythonAPI::string_object(const std::string &str)
+{
+#if PY_MAJOR_VERSION >= 3
+    return PyUnicode_FromString(str.c_str());
+#else
+    return PyString_FromString(str.c_str());
+#endif
+}
 
+PyObject *PythonAPI::buffer_object(const PythonBuffer &buffer)
+{
+#if PY_MAJOR_VERSION >= 3
+    return PyMemoryView_FromMemory((char *) buffer.data, buffer.bytes,
+        PyBUF_READ);
+#else
+    return PyBuffer_FromMemory((void *) buffer.data, buffer.bytes);
+#endif
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -1,56 +1,99 @@
 import os
+import sys
 import time
+import threading
+import traceback
+import numpy as np
 import matplotlib.pyplot as plt 
 from matplotlib import rc
 
 
-def read_file(filename):
-    lineList = [line.rstrip('\n') for line in open(filename)]
-    return lineList
+# Every call selects its own figure first; the lock keeps the selection and
+# the pyplot call together when several threads plot at once
+_lock = threading.RLock()
 
-def fig_init(fig_num):
-    plt.figure(num=int(fig_num));
+
+def select_figure(fig):
+    # Numeric ids are matplotlib figure numbers, others are figure labels
+    num = int(fig) if fig.lstrip('-').isdigit() else fig
+    return plt.figure(num=num)
+
+def fig_init(fig):
+    with _lock:
+        select_figure(fig)
     return 0;
 
-def plot2D(vec1_path, vec2_path, fmt, lin, mark, lab):
-    x = read_file(vec1_path); x = [float(i) for i in x]
-    y = read_file(vec2_path); y = [float(i) for i in y]
-    plt.plot(x, y, fmt, linewidth=int(lin), markersize=int(mark), label=lab); 
-    if (lab):
-        plt.legend()
-    os.remove(vec1_path); os.remove(vec2_path)
+def plot2D(vec1_buf, vec2_buf, fig, dtype, fmt, lin, mark, lab):
+    # The buffers alias C++ memory, copy before matplotlib keeps a reference
+    x = np.array(np.frombuffer(vec1_buf, dtype=dtype))
+    y = np.array(np.frombuffer(vec2_buf, dtype=dtype))
+    with _lock:
+        select_figure(fig)
+        plt.plot(x, y, fmt, linewidth=int(lin), markersize=int(mark), label=lab); 
+        if (lab):
+            plt.legend()
     return 0;
 
-def set_xlabel(in_text, latex_state, in_fontsize, in_font):
-    plt.rc('text', usetex=(latex_state==("True")))
-    plt.rc('font', family=in_font)
-    plt.xlabel(in_text,fontsize=in_fontsize)
+def set_xlabel(fig, in_text, latex_state, in_fontsize, in_font):
+    with _lock:
+        select_figure(fig)
+        plt.rc('text', usetex=(latex_state==("True")))
+        plt.rc('font', family=in_font)
+        plt.xlabel(in_text,fontsize=in_fontsize)
     return 0;
 
-def set_ylabel(in_text, latex_state, in_fontsize, in_font):
-    plt.rc('text', usetex=(latex_state==("True")))
-    plt.rc('font', family=in_font)
-    plt.ylabel(in_text,fontsize=in_fontsize)
+def set_ylabel(fig, in_text, latex_state, in_fontsize, in_font):
+    with _lock:
+        select_figure(fig)
+        plt.rc('text', usetex=(latex_state==("True")))
+        plt.rc('font', family=in_font)
+        plt.ylabel(in_text,fontsize=in_fontsize)
     return 0;
 
-def set_title(in_text, latex_state, in_fontsize, in_font):
-    plt.rc('text', usetex=(latex_state==("True")))
-    plt.rc('font', family=in_font)
-    plt.title(in_text,fontsize=in_fontsize)
+def set_title(fig, in_text, latex_state, in_fontsize, in_font):
+    with _lock:
+        select_figure(fig)
+        plt.rc('text', usetex=(latex_state==("True")))
+        plt.rc('font', family=in_font)
+        plt.title(in_text,fontsize=in_fontsize)
     return 0;
 
-def subplot(rows, cols, fig):
-    plt.subplot(int(rows), int(cols), int(fig))
+def subplot(fig, rows, cols, index):
+    with _lock:
+        select_figure(fig)
+        plt.subplot(int(rows), int(cols), int(index))
     return 0;
 
-def show(arg):
+def show(fig, arg):
     plt.show()
     return 0;
 
-def grid(arg):
-    plt.grid()
+def grid(fig, arg):
+    with _lock:
+        select_figure(fig)
+        plt.grid()
     return 0;
 
-def savefig(filepath):
-    plt.savefig(filepath)
-    return 0
\ No newline at end of file
+def savefig(fig, filepath):
+    with _lock:
+        select_figure(fig).savefig(filepath)
+    return 0
+
+def close(fig, arg):
+    with _lock:
+        plt.close(select_figure(fig))
+    return 0
+
+def run_batch(calls):
+    # Each call is (function_name, arg1, arg2, ...), failures do not stop
+    # the remaining calls
+    done = []
+    for call in calls:
+        try:
+            globals()[call[0]](*call[1:])
+            done.append(True)
+        except Exception:
+            traceback.print_exc()
+            done.append(False)
+    sys.stderr.flush()
+    return done
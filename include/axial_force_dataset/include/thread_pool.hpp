@@ -0,0 +1,111 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+
+/**
+ * Fixed size pool of worker threads that executes submitted tasks in FIFO
+ * order. The destructor finishes the queued tasks before joining the workers.
+**/
+class ThreadPool
+{
+    public:
+        ThreadPool(unsigned int threads_num=0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        /**
+         * Queues a callable for execution.
+         * @param task Callable without arguments.
+         * @return Future holding the result (or exception) of the task.
+        **/
+        template <typename F>
+        auto submit(F task) -> std::future<decltype(task())>;
+
+        unsigned int get_threads_num(void) const { return m_workers.size(); }
+
+    private:
+        std::vector<std::thread> m_workers;
+        std::queue<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        bool m_stop = false;
+
+        void worker_loop(void);
+};
+
+
+/**
+ * @param threads_num Number of workers (0 selects the hardware concurrency).
+**/
+ThreadPool::ThreadPool(unsigned int threads_num)
+{
+    if (threads_num == 0) { threads_num = std::thread::hardware_concurrency(); }
+    if (threads_num == 0) { threads_num = 1; }
+
+    for (unsigned int i = 0; i < threads_num; i++)
+    {
+        m_workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+template <typename F>
+auto ThreadPool::submit(F task) -> std::future<decltype(task())>
+{
+    typedef decltype(task()) R;
+
+    auto packaged = std::make_shared<std::packaged_task<R()>>(task);
+    std::future<R> result = packaged->get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push([packaged]() { (*packaged)(); });
+    }
+
+    m_cond.notify_one();
+    return result;
+}
+
+void ThreadPool::worker_loop(void)
+{
+    while (true)
+    {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+
+            if (m_stop && m_tasks.empty()) { return; }
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+
+        task();
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_cond.notify_all();
+    for (size_t i = 0; i < m_workers.size(); i++) { m_workers[i].join(); }
+}
+
+
+#endif
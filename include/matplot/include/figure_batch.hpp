@@ -0,0 +1,210 @@
+#ifndef FIGURE_BATCH_H
+#define FIGURE_BATCH_H
+
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <exception>
+#include <cerrno>
+#include <cstdio>
+#include <csignal>
+#include <thread>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#ifndef MATPLOT_NO_PYTHON
+#include "pythonAPI.hpp"
+#endif
+
+
+/**
+ * Renders independent figures in parallel worker processes. Every job is a
+ * callable that builds and saves one figure (for example with its own
+ * MatPlot instance); the workers are forked from the calling process and
+ * take the jobs from a shared pipe, so each process owns its interpreter
+ * and matplotlib state.
+**/
+class FigureBatch
+{
+    public:
+        /**
+         * @param processes_num Number of worker processes (0 selects the
+         * hardware concurrency).
+        **/
+        FigureBatch(unsigned int processes_num=0);
+
+        /**
+         * Adds a job. A job fails if it throws (e.g. the future returned by
+         * MatPlot::savefig) or if its worker dies.
+        **/
+        void add(std::function<void()> job) { m_jobs.push_back(job); }
+
+        size_t get_size(void) const { return m_jobs.size(); }
+
+        /**
+         * Runs the queued jobs and clears the queue.
+         * @return Success flag of every job, in insertion order.
+        **/
+        std::vector<bool> run(void);
+
+    private:
+        unsigned int m_processes_num;
+        std::vector<std::function<void()>> m_jobs;
+
+        pid_t spawn_worker(int jobs_fd[2], int results_fd[2]);
+        static bool read_full(int fd, void *buf, size_t size);
+        static bool write_full(int fd, const void *buf, size_t size);
+};
+
+
+FigureBatch::FigureBatch(unsigned int processes_num)
+{
+    if (processes_num == 0) { processes_num = std::thread::hardware_concurrency(); }
+    if (processes_num == 0) { processes_num = 1; }
+    m_processes_num = processes_num;
+}
+
+/**************** Methods *****************/
+
+std::vector<bool> FigureBatch::run(void)
+{
+    std::vector<bool> success(m_jobs.size(), false);
+    if (m_jobs.empty()) { return success; }
+
+    int jobs_pipe[2]; int results_pipe[2];
+    if (pipe(jobs_pipe) != 0) { return success; }
+    if (pipe(results_pipe) != 0)
+    {
+        close(jobs_pipe[0]); close(jobs_pipe[1]);
+        return success;
+    }
+
+    // Pending output would be flushed again by every worker
+    std::fflush(stdout); std::fflush(stderr); std::cout.flush();
+
+    unsigned int workers_num = std::min<size_t>(m_processes_num, m_jobs.size());
+    std::vector<pid_t> workers;
+    for (unsigned int i = 0; i < workers_num; i++)
+    {
+        pid_t pid = spawn_worker(jobs_pipe, results_pipe);
+        if (pid > 0) { workers.push_back(pid); }
+    }
+    close(jobs_pipe[0]); close(results_pipe[1]);
+
+    if (workers.empty())
+    {
+        close(jobs_pipe[1]); close(results_pipe[0]);
+        m_jobs.clear();
+        return success;
+    }
+
+    // Job indices are 4-byte records, atomic in the pipe and taken one at a
+    // time by the workers. They are fed by a thread while the results are
+    // read, so neither pipe can fill up and block the other side.
+    void (*sigpipe_handler)(int) = std::signal(SIGPIPE, SIG_IGN);
+    int jobs_fd = jobs_pipe[1]; u_int32_t jobs_num = m_jobs.size();
+    std::thread feeder([jobs_fd, jobs_num]() {
+        for (u_int32_t i = 0; i < jobs_num; i++)
+        {
+            if (!write_full(jobs_fd, &i, sizeof(i))) { break; }
+        }
+        close(jobs_fd);
+    });
+
+    unsigned char record[5];
+    while (read_full(results_pipe[0], record, sizeof(record)))
+    {
+        u_int32_t index;
+        std::copy(record, record + 4, (unsigned char *) &index);
+        if (index < success.size()) { success[index] = (record[4] == 1); }
+    }
+    close(results_pipe[0]);
+    feeder.join();
+    std::signal(SIGPIPE, sigpipe_handler);
+
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        int status;
+        while (waitpid(workers[i], &status, 0) == -1 && errno == EINTR) {}
+    }
+
+    m_jobs.clear();
+    return success;
+}
+
+
+pid_t FigureBatch::spawn_worker(int jobs_fd[2], int results_fd[2])
+{
+#ifndef MATPLOT_NO_PYTHON
+    PyGILState_STATE gil;
+    bool python = PythonSession::before_fork(&gil);
+#endif
+
+    pid_t pid = fork();
+
+#ifndef MATPLOT_NO_PYTHON
+    if (python && pid == 0) { PythonSession::after_fork_child(gil); }
+    else if (python) { PythonSession::after_fork_parent(gil); }
+#endif
+
+    if (pid != 0) { return pid; }
+
+    // Worker: take jobs until the pipe is empty and closed
+    close(jobs_fd[1]); close(results_fd[0]);
+
+    u_int32_t index;
+    while (read_full(jobs_fd[0], &index, sizeof(index)))
+    {
+        unsigned char done = 1;
+        try { m_jobs[index](); }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Figure job " << index << " failed: " << e.what()
+                << std::endl;
+            done = 0;
+        }
+        catch (...) { done = 0; }
+
+        unsigned char record[5];
+        std::copy((unsigned char *) &index, (unsigned char *) &index + 4, record);
+        record[4] = done;
+        write_full(results_fd[1], record, sizeof(record));
+    }
+
+    std::fflush(stdout); std::fflush(stderr); std::cout.flush();
+
+    // Skip the static destructors of the parent's objects
+    _exit(0);
+}
+
+
+bool FigureBatch::read_full(int fd, void *buf, size_t size)
+{
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t n = read(fd, (char *) buf + done, size - done);
+        if (n == -1 && errno == EINTR) { continue; }
+        if (n <= 0) { return false; }
+        done += n;
+    }
+    return true;
+}
+
+bool FigureBatch::write_full(int fd, const void *buf, size_t size)
+{
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t n = write(fd, (const char *) buf + done, size - done);
+        if (n == -1 && errno == EINTR) { continue; }
+        if (n <= 0) { return false; }
+        done += n;
+    }
+    return true;
+}
+
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef PYTHON_CALL_H
+#define PYTHON_CALL_H
+
+#include <string>
+#include <vector>
+
+
+/**
+ * Read-only view of a contiguous numeric array handed to Python through the
+ * buffer protocol (buffer object in Python 2, memoryview in Python 3). The
+ * memory is not copied and must stay valid for the duration of the call.
+**/
+struct PythonBuffer
+{
+    const void *data;
+    size_t bytes;
+    std::string dtype; /// NumPy dtype of the elements.
+
+    static PythonBuffer from(const float *mem, size_t n,
+        std::vector<double> &scratch);
+    static PythonBuffer from(const double *mem, size_t n,
+        std::vector<double> &scratch);
+
+    // Other element types are widened to double in the scratch vector
+    template <typename eT>
+    static PythonBuffer from(const eT *mem, size_t n,
+        std::vector<double> &scratch);
+};
+
+
+/**
+ * Deferred function call that owns copies of its arguments, used to queue
+ * calls for another thread.
+**/
+struct PythonCall
+{
+    std::string script_abs_dir;
+    std::string script_name;
+    std::string function_name;
+    std::vector<std::vector<char>> buffers; /// Raw bytes of the array arguments.
+    std::vector<std::string> args;
+};
+
+
+PythonBuffer PythonBuffer::from(const float *mem, size_t n,
+    std::vector<double> &)
+{
+    return PythonBuffer{mem, n * sizeof(float), "float32"};
+}
+
+PythonBuffer PythonBuffer::from(const double *mem, size_t n,
+    std::vector<double> &)
+{
+    return PythonBuffer{mem, n * sizeof(double), "float64"};
+}
+
+template <typename eT>
+PythonBuffer PythonBuffer::from(const eT *mem, size_t n,
+    std::vector<double> &scratch)
+{
+    scratch.assign(mem, mem + n);
+    return PythonBuffer{scratch.data(), n * sizeof(double), "float64"};
+}
+
+
+#endif
@@ -0,0 +1,390 @@
+#ifndef RASTER_CANVAS_H
+#define RASTER_CANVAS_H
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <sys/types.h>
+
+
+struct PlotColor
+{
+    unsigned char r, g, b;
+};
+
+
+/**
+ * Minimal RGB rasteriser used by the native MatPlot backend: anti-aliased
+ * thick (optionally dashed) segments, discs, rectangles, 5x7 bitmap text
+ * and an uncompressed PNG encoder (no external dependencies).
+**/
+class RasterCanvas
+{
+    public:
+        RasterCanvas(int width, int height, PlotColor background={255, 255, 255});
+
+        int get_width(void) const { return m_width; }
+        int get_height(void) const { return m_height; }
+
+        /**
+         * Restricts the drawing to the rectangle [x0, x1) x [y0, y1).
+        **/
+        void set_clip(int x0, int y0, int x1, int y1);
+        void reset_clip(void) { set_clip(0, 0, m_width, m_height); }
+
+        /**
+         * Draws a segment of the given width. With a dash pattern (on, off
+         * lengths in pixels) the phase starts at dash_offset, the length
+         * already covered along the polyline.
+        **/
+        void draw_line(double x0, double y0, double x1, double y1,
+            double width, PlotColor color, const std::vector<double> &dash={},
+            double dash_offset=0);
+
+        void fill_circle(double cx, double cy, double radius, PlotColor color);
+        void fill_rect(double x0, double y0, double x1, double y1,
+            PlotColor color);
+
+        /**
+         * Draws text with the built-in 5x7 font (printable ASCII).
+         * @param anchor_x 0 left, 0.5 centred, 1 right aligned.
+         * @param anchor_y 0 top, 0.5 centred, 1 bottom aligned.
+         * @param vertical Rotates the text by 90 degrees (bottom to top).
+        **/
+        void draw_text(double x, double y, const std::string &text, int scale,
+            PlotColor color, double anchor_x=0, double anchor_y=0,
+            bool vertical=false);
+
+        static int text_width(const std::string &text, int scale) {
+            return (text.empty()) ? 0 : (6 * text.size() - 1) * scale;
+        }
+        static int text_height(int scale) { return 7 * scale; }
+
+        bool save_png(const std::string &filename) const;
+
+    private:
+        int m_width;
+        int m_height;
+        int m_clip[4];
+        std::vector<unsigned char> m_pixels;
+
+        void blend(int x, int y, PlotColor color, double alpha);
+
+        static const unsigned char *glyph(char c);
+        static u_int32_t crc32(const unsigned char *data, size_t size,
+            u_int32_t crc=0);
+        static void put_u32(std::vector<unsigned char> &out, u_int32_t val);
+        static void put_chunk(std::vector<unsigned char> &out, const char *type,
+            const std::vector<unsigned char> &data);
+};
+
+
+RasterCanvas::RasterCanvas(int width, int height, PlotColor background) :
+    m_width(width), m_height(height), m_pixels(3 * width * height)
+{
+    for (size_t i = 0; i < m_pixels.size(); i += 3)
+    {
+        m_pixels[i] = background.r;
+        m_pixels[i + 1] = background.g;
+        m_pixels[i + 2] = background.b;
+    }
+    reset_clip();
+}
+
+void RasterCanvas::set_clip(int x0, int y0, int x1, int y1)
+{
+    m_clip[0] = std::max(0, x0); m_clip[1] = std::max(0, y0);
+    m_clip[2] = std::min(m_width, x1); m_clip[3] = std::min(m_height, y1);
+}
+
+void RasterCanvas::blend(int x, int y, PlotColor color, double alpha)
+{
+    if (x < m_clip[0] || y < m_clip[1] || x >= m_clip[2] || y >= m_clip[3])
+    {
+        return;
+    }
+    if (alpha <= 0) { return; }
+    if (alpha > 1) { alpha = 1; }
+
+    unsigned char *p = &m_pixels[3 * (y * m_width + x)];
+    p[0] = (unsigned char) (p[0] + (color.r - p[0]) * alpha + 0.5);
+    p[1] = (unsigned char) (p[1] + (color.g - p[1]) * alpha + 0.5);
+    p[2] = (unsigned char) (p[2] + (color.b - p[2]) * alpha + 0.5);
+}
+
+
+/**
+ * The coverage of every pixel of the bounding box is the distance of its
+ * centre to the segment, smoothed over one pixel.
+*/
+void RasterCanvas::draw_line(double x0, double y0, double x1, double y1,
+    double width, PlotColor color, const std::vector<double> &dash,
+    double dash_offset)
+{
+    const double half = 0.5 * std::max(width, 1.0);
+    const double dx = x1 - x0; const double dy = y1 - y0;
+    const double len2 = dx * dx + dy * dy;
+    const double len = std::sqrt(len2);
+
+    double period = 0;
+    for (size_t i = 0; i < dash.size(); i++) { period += dash[i]; }
+
+    int bx0 = std::max(m_clip[0], (int) std::floor(std::min(x0, x1) - half - 1));
+    int bx1 = std::min(m_clip[2] - 1, (int) std::ceil(std::max(x0, x1) + half + 1));
+    int by0 = std::max(m_clip[1], (int) std::floor(std::min(y0, y1) - half - 1));
+    int by1 = std::min(m_clip[3] - 1, (int) std::ceil(std::max(y0, y1) + half + 1));
+
+    for (int y = by0; y <= by1; y++)
+    {
+        for (int x = bx0; x <= bx1; x++)
+        {
+            const double px = x + 0.5 - x0; const double py = y + 0.5 - y0;
+            double t = (len2 > 0) ? (px * dx + py * dy) / len2 : 0;
+            t = std::min(1.0, std::max(0.0, t));
+
+            const double ex = px - t * dx; const double ey = py - t * dy;
+            const double alpha = half + 0.5 - std::sqrt(ex * ex + ey * ey);
+            if (alpha <= 0) { continue; }
+
+            if (period > 0)
+            {
+                double s = std::fmod(dash_offset + t * len, period);
+                bool on = true;
+                for (size_t i = 0; i < dash.size(); i++)
+                {
+                    if (s < dash[i]) { break; }
+                    s -= dash[i]; on = !on;
+                }
+                if (!on) { continue; }
+            }
+
+            blend(x, y, color, alpha);
+        }
+    }
+}
+
+void RasterCanvas::fill_circle(double cx, double cy, double radius,
+    PlotColor color)
+{
+    int bx0 = (int) std::floor(cx - radius - 1); int bx1 = (int) std::ceil(cx + radius + 1);
+    int by0 = (int) std::floor(cy - radius - 1); int by1 = (int) std::ceil(cy + radius + 1);
+
+    for (int y = by0; y <= by1; y++)
+    {
+        for (int x = bx0; x <= bx1; x++)
+        {
+            double ex = x + 0.5 - cx; double ey = y + 0.5 - cy;
+            blend(x, y, color, radius + 0.5 - std::sqrt(ex * ex + ey * ey));
+        }
+    }
+}
+
+void RasterCanvas::fill_rect(double x0, double y0, double x1, double y1,
+    PlotColor color)
+{
+    for (int y = (int) std::floor(y0); y < (int) std::ceil(y1); y++)
+    {
+        for (int x = (int) std::floor(x0); x < (int) std::ceil(x1); x++)
+        {
+            blend(x, y, color, 1);
+        }
+    }
+}
+
+void RasterCanvas::draw_text(double x, double y, const std::string &text,
+    int scale, PlotColor color, double anchor_x, double anchor_y,
+    bool vertical)
+{
+    const int w = text_width(text, scale); const int h = text_height(scale);
+    const int ox = (int) std::floor(-anchor_x * w + 0.5);
+    const int oy = (int) std::floor(-anchor_y * h + 0.5);
+
+    for (size_t k = 0; k < text.size(); k++)
+    {
+        const unsigned char *cols = glyph(text[k]);
+
+        for (int c = 0; c < 5; c++)
+        {
+            for (int r = 0; r < 8; r++)
+            {
+                if (!(cols[c] & (1 << r))) { continue; }
+
+                // Position in the unrotated text box
+                int tx = ox + (6 * k + c) * scale; int ty = oy + r * scale;
+
+                for (int sy = 0; sy < scale; sy++)
+                {
+                    for (int sx = 0; sx < scale; sx++)
+                    {
+                        if (vertical)
+                        {
+                            blend((int) x + ty + sy, (int) y - tx - sx, color, 1);
+                        }
+                        else
+                        {
+                            blend((int) x + tx + sx, (int) y + ty + sy, color, 1);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/**
+ * Columns of the 5x7 glyph (bit 0 is the top row, bit 7 holds descenders).
+*/
+const unsigned char *RasterCanvas::glyph(char c)
+{
+    static const unsigned char font[95][5] = {
+        {0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, // space !
+        {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7F,0x14,0x7F,0x14}, // " #
+        {0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62}, // $ %
+        {0x36,0x49,0x56,0x20,0x50}, {0x00,0x00,0x07,0x00,0x00}, // & '
+        {0x00,0x1C,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1C,0x00}, // ( )
+        {0x2A,0x1C,0x7F,0x1C,0x2A}, {0x08,0x08,0x3E,0x08,0x08}, // * +
+        {0x00,0x50,0x30,0x00,0x00}, {0x08,0x08,0x08,0x08,0x08}, // , -
+        {0x00,0x60,0x60,0x00,0x00}, {0x20,0x10,0x08,0x04,0x02}, // . /
+        {0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00}, // 0 1
+        {0x72,0x49,0x49,0x49,0x46}, {0x21,0x41,0x49,0x4D,0x33}, // 2 3
+        {0x18,0x14,0x12,0x7F,0x10}, {0x27,0x45,0x45,0x45,0x39}, // 4 5
+        {0x3C,0x4A,0x49,0x49,0x31}, {0x41,0x21,0x11,0x09,0x07}, // 6 7
+        {0x36,0x49,0x49,0x49,0x36}, {0x46,0x49,0x49,0x29,0x1E}, // 8 9
+        {0x00,0x36,0x36,0x00,0x00}, {0x00,0x56,0x36,0x00,0x00}, // : ;
+        {0x08,0x14,0x22,0x41,0x00}, {0x14,0x14,0x14,0x14,0x14}, // < =
+        {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x51,0x09,0x06}, // > ?
+        {0x3E,0x41,0x5D,0x55,0x1E}, {0x7C,0x12,0x11,0x12,0x7C}, // @ A
+        {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22}, // B C
+        {0x7F,0x41,0x41,0x22,0x1C}, {0x7F,0x49,0x49,0x49,0x41}, // D E
+        {0x7F,0x09,0x09,0x09,0x01}, {0x3E,0x41,0x49,0x49,0x7A}, // F G
+        {0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00}, // H I
+        {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41}, // J K
+        {0x7F,0x40,0x40,0x40,0x40}, {0x7F,0x02,0x0C,0x02,0x7F}, // L M
+        {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E}, // N O
+        {0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, // P Q
+        {0x7F,0x09,0x19,0x29,0x46}, {0x46,0x49,0x49,0x49,0x31}, // R S
+        {0x01,0x01,0x7F,0x01,0x01}, {0x3F,0x40,0x40,0x40,0x3F}, // T U
+        {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F}, // V W
+        {0x63,0x14,0x08,0x14,0x63}, {0x07,0x08,0x70,0x08,0x07}, // X Y
+        {0x61,0x51,0x49,0x45,0x43}, {0x00,0x7F,0x41,0x41,0x00}, // Z [
+        {0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x7F,0x00}, // \ ]
+        {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40}, // ^ _
+        {0x00,0x01,0x02,0x04,0x00}, {0x20,0x54,0x54,0x54,0x78}, // ` a
+        {0x7F,0x48,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x20}, // b c
+        {0x38,0x44,0x44,0x48,0x7F}, {0x38,0x54,0x54,0x54,0x18}, // d e
+        {0x08,0x7E,0x09,0x01,0x02}, {0x18,0xA4,0xA4,0xA4,0x7C}, // f g
+        {0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, // h i
+        {0x40,0x80,0x84,0x7D,0x00}, {0x7F,0x10,0x28,0x44,0x00}, // j k
+        {0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x18,0x04,0x78}, // l m
+        {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38}, // n o
+        {0xFC,0x24,0x24,0x24,0x18}, {0x18,0x24,0x24,0x18,0xFC}, // p q
+        {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x20}, // r s
+        {0x04,0x3F,0x44,0x40,0x20}, {0x3C,0x40,0x40,0x20,0x7C}, // t u
+        {0x1C,0x20,0x40,0x20,0x1C}, {0x3C,0x40,0x30,0x40,0x3C}, // v w
+        {0x44,0x28,0x10,0x28,0x44}, {0x1C,0xA0,0xA0,0xA0,0x7C}, // x y
+        {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00}, // z {
+        {0x00,0x00,0x7F,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00}, // | }
+        {0x08,0x04,0x08,0x10,0x08}                               // ~
+    };
+
+    if (c < 32 || c > 126) { c = '?'; }
+    return font[c - 32];
+}
+
+
+/**
+ * Writes an 8-bit RGB PNG. The image data is stored in uncompressed deflate
+ * blocks, so no compression library is needed.
+*/
+bool RasterCanvas::save_png(const std::string &filename) const
+{
+    // Filtered scanlines (filter type 0)
+    std::vector<unsigned char> raw;
+    raw.reserve((3 * m_width + 1) * m_height);
+    for (int y = 0; y < m_height; y++)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), m_pixels.begin() + 3 * y * m_width,
+            m_pixels.begin() + 3 * (y + 1) * m_width);
+    }
+
+    // zlib stream of stored blocks
+    std::vector<unsigned char> zdata = {0x78, 0x01};
+    u_int32_t a = 1; u_int32_t b = 0;
+    for (size_t pos = 0; pos < raw.size() || pos == 0; )
+    {
+        size_t block = std::min<size_t>(65535, raw.size() - pos);
+        bool last = (pos + block == raw.size());
+
+        zdata.push_back(last ? 1 : 0);
+        zdata.push_back(block & 0xFF); zdata.push_back(block >> 8);
+        zdata.push_back(~block & 0xFF); zdata.push_back((~block >> 8) & 0xFF);
+
+        for (size_t i = pos; i < pos + block; i++)
+        {
+            a = (a + raw[i]) % 65521; b = (b + a) % 65521;
+        }
+        zdata.insert(zdata.end(), raw.begin() + pos, raw.begin() + pos + block);
+
+        pos += block;
+        if (last) { break; }
+    }
+    put_u32(zdata, (b << 16) | a);
+
+    std::vector<unsigned char> header;
+    put_u32(header, m_width); put_u32(header, m_height);
+    header.push_back(8); header.push_back(2); // 8-bit RGB
+    header.push_back(0); header.push_back(0); header.push_back(0);
+
+    std::vector<unsigned char> out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    put_chunk(out, "IHDR", header);
+    put_chunk(out, "IDAT", zdata);
+    put_chunk(out, "IEND", std::vector<unsigned char>());
+
+    FILE *file = std::fopen(filename.c_str(), "wb");
+    if (file == NULL) { return false; }
+    bool written = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+    return (std::fclose(file) == 0) && written;
+}
+
+u_int32_t RasterCanvas::crc32(const unsigned char *data, size_t size,
+    u_int32_t crc)
+{
+    // Thread-safe one-time initialisation
+    static const std::vector<u_int32_t> table = []() {
+        std::vector<u_int32_t> t(256);
+        for (u_int32_t n = 0; n < 256; n++)
+        {
+            u_int32_t c = n;
+            for (int k = 0; k < 8; k++) { c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1; }
+            t[n] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) { crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8); }
+    return ~crc;
+}
+
+void RasterCanvas::put_u32(std::vector<unsigned char> &out, u_int32_t val)
+{
+    out.push_back(val >> 24); out.push_back((val >> 16) & 0xFF);
+    out.push_back((val >> 8) & 0xFF); out.push_back(val & 0xFF);
+}
+
+void RasterCanvas::put_chunk(std::vector<unsigned char> &out, const char *type,
+    const std::vector<unsigned char> &data)
+{
+    put_u32(out, data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put_u32(out, crc32(&out[start], out.size() - start));
+}
+
+
+#endif
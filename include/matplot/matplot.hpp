@@ -2,13 +2,35 @@
 #define MAT_PLOT_H
 
 #include <iostream>
-#include <fstream>
-#include <sys/types.h>
-#include <sys/stat.h>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <future>
+#include <stdexcept>
 #include <unistd.h>
-#include <Python.h>
 
+#include "./include/python_call.hpp"
+#include "./include/downsampling.hpp"
+#include "./include/native_figure.hpp"
+#include "./include/figure_batch.hpp"
+
+// Defining MATPLOT_NO_PYTHON builds MatPlot without the Python dependency
+// (only the native backend is available)
+#ifndef MATPLOT_NO_PYTHON
+#include <Python.h>
 #include "./include/pythonAPI.hpp"
+#include "./include/plot_queue.hpp"
+#define MATPLOT_DEFAULT_BACKEND MatPlotBackend::python
+#else
+#define MATPLOT_DEFAULT_BACKEND MatPlotBackend::native
+#endif
+
+
+/**
+ * python: matplotlib through the embedded interpreter.
+ * native: built-in SVG/PNG writer (no interpreter, thread-safe per instance).
+**/
+enum class MatPlotBackend {python, native};
 
 
 template <class M>
@@ -17,9 +39,20 @@ class MatPlot
 {   
     public:
 
-        MatPlot(int fig_num=1);
-
-        void plot2D(M vec1, M vec2, std::string fmt="b", 
+        /**
+         * Every call of the python backend targets the figure of the
+         * instance, so independent instances can be used concurrently.
+         * @param fig_num Figure number (instances with the same number share
+         * the figure); 0 selects a unique figure.
+         * @param async If true, the calls are queued to the plotting worker
+         * thread instead of being executed by the calling thread (python
+         * backend only).
+         * @param backend Figure renderer.
+        **/
+        MatPlot(int fig_num=0, bool async=false,
+            MatPlotBackend backend=MATPLOT_DEFAULT_BACKEND);
+
+        void plot2D(const M &vec1, const M &vec2, std::string fmt="b", 
             int linewidth=2, int markersize=5, std::string lab="");
 
         void show(void);
@@ -37,136 +70,291 @@ class MatPlot
         void set_title(std::string text, bool latex=true, int fontsize=11, 
             std::string font="serif");
         
-        void savefig(std::string filename);
+        /**
+         * The native backend writes .svg and .png files.
+         * @return Future that is set once the figure has been written (it
+         * is already set in synchronous mode).
+        **/
+        std::future<void> savefig(std::string filename);
+
+        /**
+         * Releases the figure (matplotlib keeps figures until closed).
+        **/
+        void close(void);
+
+        /**
+         * Switches between queued and synchronous execution. Pending queued
+         * calls are flushed when leaving the asynchronous mode.
+        **/
+        void set_async(bool state);
+
+        /**
+         * Blocks until every queued plotting call has been executed.
+        **/
+        void flush(void);
+
+        /**
+         * Point budget of plot2D. Longer series are reduced with the given
+         * method before they are plotted (0 disables the reduction).
+        **/
+        void set_max_points(size_t max_points,
+            Downsampling::method mode=Downsampling::method::lttb);
 
     private:
         const std::string lib_rel_path = "./include/matplot/";
         const std::string script_rel_dir = lib_rel_path + "scripts/";
-        const std::string share_rel_dir = lib_rel_path + "share/";
         const std::string script_name = "python_matplot"; 
 
-        std::string vector_to_text(M matrix, std::string id);
+        size_t m_max_points = 0;
+        Downsampling::method m_downsampling = Downsampling::method::lttb;
+        bool m_async = false;
+        std::string m_fig_id;
+        std::shared_ptr<NativeFigure> m_native;
+
+        std::future<void> call(const std::string &function_name,
+            std::string *args, int arg_num,
+            const PythonBuffer *buffers=NULL, int buffer_num=0);
 
         int get_current_path(void);
 
 };
 
 template <class M>
-MatPlot<M>::MatPlot(int fig_num)
+MatPlot<M>::MatPlot(int fig_num, bool async, MatPlotBackend backend) :
+    m_async(async)
 {
+    if (backend == MatPlotBackend::native)
+    {
+        m_native = std::make_shared<NativeFigure>();
+        m_async = false;
+        return;
+    }
+
+    static std::atomic<unsigned int> unique_num(0);
+    m_fig_id = (fig_num != 0) ? std::to_string(fig_num) : ("matplot-" +
+        std::to_string(getpid()) + "-" + std::to_string(++unique_num));
+
     std::string function_name = "fig_init";
-    std::string args[1] = {std::to_string(fig_num)};
+    call(function_name, NULL, 0);
+}
+
+template <class M>
+void MatPlot<M>::set_max_points(size_t max_points, Downsampling::method mode)
+{
+    m_max_points = max_points;
+    m_downsampling = mode;
+}
+
+template <class M>
+void MatPlot<M>::close(void)
+{
+    if (m_native) { m_native = std::make_shared<NativeFigure>(); return; }
+
+    std::string function_name = "close";
+    std::string args[1] = {""};
+    call(function_name, args, sizeof(args)/sizeof(args[0]));
+}
+
+template <class M>
+void MatPlot<M>::set_async(bool state)
+{
+    if (m_async && !state) { flush(); }
+    m_async = state && !m_native;
+}
 
-    PythonAPI::python_function_call(script_rel_dir, script_name, function_name, 
-        args, sizeof(args)/sizeof(args[0])); 
+template <class M>
+void MatPlot<M>::flush(void)
+{
+#ifndef MATPLOT_NO_PYTHON
+    if (!m_native) { PlotQueue::instance().flush(); }
+#endif
 }
 
 template <class M>
 void MatPlot<M>::show(void)
 {
+    if (m_native)
+    {
+        std::cerr << "MatPlot: show() is not available with the native "
+            "backend, use savefig()" << std::endl;
+        return;
+    }
+
     std::string function_name = "show";
     std::string args[1] = {""};
-    PythonAPI::python_function_call(script_rel_dir, script_name, function_name, 
-        args, sizeof(args)/sizeof(args[0])); 
+    call(function_name, args, sizeof(args)/sizeof(args[0]));
 }
 
 template <class M>
-void MatPlot<M>::savefig(std::string filename)
+std::future<void> MatPlot<M>::savefig(std::string filename)
 {
+    if (m_native)
+    {
+        std::promise<void> done;
+        if (m_native->savefig(filename)) { done.set_value(); }
+        else
+        {
+            done.set_exception(std::make_exception_ptr(std::runtime_error(
+                "Cannot write figure \"" + filename + "\"")));
+        }
+        return done.get_future();
+    }
+
     std::string function_name = "savefig";
     std::string args[1] = {filename};
-    PythonAPI::python_function_call(script_rel_dir, script_name, function_name, 
-        args, sizeof(args)/sizeof(args[0])); 
+    return call(function_name, args, sizeof(args)/sizeof(args[0]));
 }
 
 template <class M>
 void MatPlot<M>::grid(void)
 {
+    if (m_native) { m_native->grid(); return; }
+
     std::string function_name = "grid";
     std::string args[1] = {""};
-    PythonAPI::python_function_call(script_rel_dir, script_name, function_name, 
-        args, sizeof(args)/sizeof(args[0])); 
+    call(function_name, args, sizeof(args)/sizeof(args[0]));
 }
 
 template <class M>
 void MatPlot<M>::subplot(int rows, int cols, int fig)
 {
+    if (m_native) { m_native->subplot(rows, cols, fig); return; }
+
     std::string function_name = "subplot";
     std::string args[3] = {std::to_string(rows), std::to_string(cols), std::to_string(fig)};
-    PythonAPI::python_function_call(script_rel_dir, script_name, function_name, 
-        args, sizeof(args)/sizeof(args[0])); 
+    call(function_name, args, sizeof(args)/sizeof(args[0]));
 }
 
 template <class M>
 void MatPlot<M>::set_xlabel(std::string text, bool latex, int fontsize, 
     std::string font)
 {
+    if (m_native) { m_native->set_xlabel(text, fontsize, font); return; }
+
     std::string latex_state = (latex) ? ("True") : ("False");
     std::string function_name = "set_xlabel";
     std::string args[4] = {text, latex_state, std::to_string(fontsize), font};
-    PythonAPI::python_function_call(script_rel_dir, script_name, function_name, 
-        args, sizeof(args)/sizeof(args[0])); 
+    call(function_name, args, sizeof(args)/sizeof(args[0]));
 }
 
 template <class M>
 void MatPlot<M>::set_ylabel(std::string text, bool latex, int fontsize, 
     std::string font)
 {
+    if (m_native) { m_native->set_ylabel(text, fontsize, font); return; }
+
     std::string latex_state = (latex) ? ("True") : ("False");
     std::string function_name = "set_ylabel";
     std::string args[4] = {text, latex_state, std::to_string(fontsize), font};
-    PythonAPI::python_function_call(script_rel_dir, script_name, function_name, 
-        args, sizeof(args)/sizeof(args[0])); 
+    call(function_name, args, sizeof(args)/sizeof(args[0]));
 }
 
 template <class M>
 void MatPlot<M>::set_title(std::string text, bool latex, int fontsize, 
     std::string font)
 {
+    if (m_native) { m_native->set_title(text, fontsize, font); return; }
+
     std::string latex_state = (latex) ? ("True") : ("False");
     std::string function_name = "set_title";
     std::string args[4] = {text, latex_state, std::to_string(fontsize), font};
-    PythonAPI::python_function_call(script_rel_dir, script_name, function_name, 
-        args, sizeof(args)/sizeof(args[0])); 
+    call(function_name, args, sizeof(args)/sizeof(args[0]));
 }
 
 
+/**
+ * The vectors are handed to Python as read-only buffers over the Armadillo
+ * memory (no intermediate files); the script copies them into NumPy arrays.
+ * Series longer than the point budget are downsampled first.
+**/
 template <class M>
-void MatPlot<M>::plot2D(M vec1, M vec2, std::string fmt, 
+void MatPlot<M>::plot2D(const M &vec1, const M &vec2, std::string fmt, 
     int linewidth, int markersize, std::string lab)
 {
-    // Create txt file from vector
-    std::string filepath_vec1 = vector_to_text(vec1, "vec1");
-    std::string filepath_vec2 = vector_to_text(vec2, "vec2");   
+    const size_t n = (vec1.n_elem < vec2.n_elem) ? vec1.n_elem : vec2.n_elem;
+    const bool reduce = (m_downsampling != Downsampling::method::none &&
+        m_max_points > 0 && n > m_max_points);
+
+    M reduced1, reduced2;
+    if (reduce)
+    {
+        Downsampling::reduce(vec1, vec2, m_max_points, m_downsampling,
+            &reduced1, &reduced2);
+    }
+    const M &x = (reduce) ? reduced1 : vec1;
+    const M &y = (reduce) ? reduced2 : vec2;
+
+    if (m_native)
+    {
+        m_native->plot(x.memptr(), y.memptr(), std::min(x.n_elem, y.n_elem),
+            fmt, linewidth, markersize, lab);
+        return;
+    }
+
+    std::vector<double> scratch1, scratch2;
+    PythonBuffer buffers[2] = {
+        PythonBuffer::from(x.memptr(), x.n_elem, scratch1),
+        PythonBuffer::from(y.memptr(), y.n_elem, scratch2)};
 
     // Python function
     std::string function_name = "plot2D";
-    std::string args[6] = {filepath_vec1, filepath_vec2, fmt, 
-        std::to_string(linewidth), std::to_string(markersize), lab};
+    std::string args[5] = {buffers[0].dtype, fmt, std::to_string(linewidth),
+        std::to_string(markersize), lab};
 
-    PythonAPI::python_function_call(script_rel_dir, script_name, function_name, 
-        args, sizeof(args)/sizeof(args[0]));
+    call(function_name, args, sizeof(args)/sizeof(args[0]),
+        buffers, sizeof(buffers)/sizeof(buffers[0]));
 }
 
 
+/**
+ * Executes the call, or queues it with copies of the buffers in
+ * asynchronous mode. The figure id is prepended to the string arguments.
+**/
 template <class M>
-std::string MatPlot<M>::vector_to_text(M vec, std::string id)
-{   
-    struct stat st = {0};
-    
-    if (stat(share_rel_dir.c_str(), &st) == -1) {
-        mkdir(share_rel_dir.c_str(), 0700);
+std::future<void> MatPlot<M>::call(const std::string &function_name,
+    std::string *args, int arg_num, const PythonBuffer *buffers,
+    int buffer_num)
+{
+#ifndef MATPLOT_NO_PYTHON
+    std::vector<std::string> fig_args(1, m_fig_id);
+    fig_args.insert(fig_args.end(), args, args + arg_num);
+
+    if (m_async)
+    {
+        PythonCall deferred;
+        deferred.script_abs_dir = script_rel_dir;
+        deferred.script_name = script_name;
+        deferred.function_name = function_name;
+        deferred.args = fig_args;
+
+        for (int i = 0; i < buffer_num; i++)
+        {
+            const char *data = (const char *) buffers[i].data;
+            deferred.buffers.push_back(std::vector<char>(data,
+                data + buffers[i].bytes));
+        }
+
+        return PlotQueue::instance().submit(std::move(deferred));
     }
 
-    std::string filename = "/" + id + ".txt";
-
-    std::string filepath = share_rel_dir + filename;
-    std::ofstream file(filepath.c_str());
-
-    if (file.is_open()) { file << vec; }
-    
-    file.close();
-    return filepath;
+    std::promise<void> done;
+    if (PythonAPI::python_function_call(script_rel_dir, script_name,
+        function_name, buffers, buffer_num, fig_args.data(), fig_args.size()))
+    {
+        done.set_value();
+    }
+    else
+    {
+        done.set_exception(std::make_exception_ptr(std::runtime_error(
+            "Python call \"" + function_name + "\" failed")));
+    }
+    return done.get_future();
+#else
+    std::promise<void> done;
+    done.set_exception(std::make_exception_ptr(std::runtime_error(
+        "MatPlot was built without Python (MATPLOT_NO_PYTHON)")));
+    return done.get_future();
+#endif
 }
 
 
@@ -1,7 +1,7 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include "./include/axial_force_dataset/axial_force_dataset.hpp"
+#include "./include/axial_force_dataset/dataset_catalog.hpp"
 
 
 int main(int argc, char *argv[])
@@ -11,21 +11,22 @@ int main(int argc, char *argv[])
 
     // std::string data_vec = "Data1";
     
-    AxialForceDataset axial_data[2];
+    DatasetCatalog catalog;
+    catalog.load(data_vec);
 
     
-    for (int i = 0; i < sizeof(axial_data) / sizeof(axial_data[0]); i++)
+    for (int i = 0; i < data_vec.size(); i++)
     {
-        axial_data[i].data_parsing(data_vec[i]);
+        AxialForceDataset &axial_data = catalog.wait(data_vec[i]);
 
-        arma::fvec time = axial_data[i].get_time();
-        arma::fvec displacemt_x = axial_data[i].get_displ_x();
+        const arma::fvec &time = axial_data.get_time();
+        const arma::fvec &displacemt_x = axial_data.get_displ_x();
 
 
-        if (axial_data[i].is_tissue_biological())
+        if (axial_data.is_tissue_biological())
         {
-            auto tissue_description = axial_data[i].get_tissue_description();
-            int organ = axial_data[i].bio_tissue_organ_index;
+            auto &tissue_description = axial_data.get_tissue_description();
+            int organ = axial_data.bio_tissue_organ_index;
             std::cout << tissue_description[organ][1] << std::endl;
         }
     }
@@ -36,4 +37,3 @@ int main(int argc, char *argv[])
 
     return 0;
 }
-